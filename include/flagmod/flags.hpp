@@ -44,6 +44,14 @@ struct Positional {
 	std::optional<std::string_view> value;
 };
 
+/// Takes every positional argument left once the single ones are filled
+template <typename T>
+struct PositionalList {
+	std::string label;
+
+	std::vector<std::string_view> values;
+};
+
 template <typename T>
 concept stringifiable = requires(T x) {
 	std::to_string(x);
@@ -95,7 +103,7 @@ class Flags {
 	bool flag_present(std::string_view str, Flag &s, Ts & ... flags) {
 		if(
 			str.starts_with("--" + s.name) ||
-			(s.short_name.has_value() && str.starts_with('-') && str.find(*s.short_name) != std::string::npos)
+			(s.short_name.has_value() && str.starts_with('-') && !str.starts_with("--") && str.find(*s.short_name) != std::string::npos)
 		) {
 			s.value = true;
 			return flag_present(str, flags...) || true;
@@ -123,6 +131,11 @@ class Flags {
 		}
 	}
 
+	template <typename T, typename ... Ts>
+	void set_positional(std::string_view str, PositionalList<T> &positional, Ts & ...) {
+		positional.values.push_back(str);
+	}
+
 	bool parse_flag(const Flag &s) {
 		return s.value;
 	}
@@ -131,9 +144,12 @@ class Flags {
 	template <typename T, bool R>
 	typename Option<T, R>::out parse_flag(const Option<T, R> &flag) {
 		if constexpr(R) {
-			if(!flag.value.has_value() && !flag.default_value.has_value()) throw RequiredFlagNotGiven(fmt::format("option --{} requires a value but wasn't given one\n{}\n", flag.name, help.format_flag_help(flag.name)));
-			else if(flag.default_value.has_value()) return *flag.default_value;
-			// fallthrough on else
+			// A given value wins over the default
+			if(!flag.value.has_value()) {
+				if(flag.default_value.has_value()) return *flag.default_value;
+				throw RequiredFlagNotGiven(fmt::format("option --{} requires a value but wasn't given one\n{}\n", flag.name, help.format_flag_help(flag.name)));
+			}
+			// fallthrough otherwise
 		}
 		else {
 			if(!flag.value.has_value()) return nullopt;
@@ -155,6 +171,21 @@ class Flags {
 		throw RequiredFlagNotGiven(fmt::format("argument {{{}}} not given", p.label));
 	}
 
+	/// @returns every value given, possibly none
+	template <typename T>
+	std::vector<T> parse_flag(const PositionalList<T> &p) {
+		std::vector<T> values;
+		for(auto value : p.values) {
+			try {
+				values.push_back(lexical_conversion<T>(value));
+			}
+			catch(InvalidArgument &e) {
+				throw InvalidArgument(fmt::format("{}\ncouldn't parse argument {{{}...}}, was given {}\n", e.msg, p.label, value));
+			}
+		}
+		return values;
+	}
+
 public:
 	Flags(int argc, char **argv) {
 		for(int i = 1; i < argc; i++) {
@@ -164,7 +195,7 @@ public:
 		help.executable = argv[0];
 	}
 
-	/// Takes a parameter pack of FlagMod::Flag, FlagMod::Switch and FlagMod::Positional
+	/// Takes a parameter pack of FlagMod::Flag, FlagMod::Switch, FlagMod::Positional and FlagMod::PositionalList
 	template <typename ... Ts>
 	auto parse(Ts ... flags) {
 		try {
@@ -269,6 +300,13 @@ public:
 		this->help.positional_help.push_back(Help::PositionalHelp{ label });
 		return Positional<T>{ label, nullopt };
 	}
+
+	/// Should come after every single positional in `parse`, which it would otherwise starve
+	template <lexically_convertible T>
+	PositionalList<T> positional_list(const std::string &label) {
+		this->help.positional_help.push_back(Help::PositionalHelp{ label + "..." });
+		return PositionalList<T>{ label, {} };
+	}
 };
 
 }
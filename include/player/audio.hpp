@@ -0,0 +1,65 @@
+#pragma once
+
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+#include <pthread.h>
+
+#include <fmt/core.h>
+
+namespace Player {
+
+/// A single mplayer kept alive between videos and driven through its slave mode, so switching files doesn't start a new process
+class Audio {
+	FILE *mplayer;
+
+	/// Without mplayer installed, or once it died, writing commands fails instead of killing the player
+	void command(const std::string &cmd) {
+		if(mplayer == nullptr) return;
+
+		// SIGPIPE is only held back for this write, a closed stdout still ends the player as usual
+		sigset_t pipe_signal, previous;
+		sigemptyset(&pipe_signal);
+		sigaddset(&pipe_signal, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &pipe_signal, &previous);
+
+		std::string line = cmd + '\n';
+		bool failed = std::fwrite(line.data(), 1, line.size(), mplayer) != line.size() || std::fflush(mplayer) != 0;
+		if(failed) {
+			// Consume the SIGPIPE the failed write raised before unblocking it
+			timespec no_wait{};
+			sigtimedwait(&pipe_signal, nullptr, &no_wait);
+
+			pclose(mplayer);
+			mplayer = nullptr;
+		}
+
+		pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+	}
+
+public:
+	Audio() {
+		mplayer = popen("mplayer -vo null -slave -idle -quiet > /dev/null 2>&1", "w");
+	}
+
+	Audio(const Audio &) = delete;
+	Audio &operator=(const Audio &) = delete;
+
+	~Audio() {
+		command("quit");
+		if(mplayer != nullptr) pclose(mplayer);
+	}
+
+	/// Replaces whatever is playing
+	void play(const std::string &path) {
+		command(fmt::format("loadfile \"{}\"", path));
+	}
+
+	void stop() {
+		command("stop");
+	}
+};
+
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "input.hpp"
+#include "recording.hpp"
+#include "temporal.hpp"
+#include "worker_pool.hpp"
+
+namespace Player {
+
+/// Converts a whole video to a recording as fast as the cores allow
+///
+/// The video is cut into segments converted in parallel, each by its own decoder, without any pacing.
+/// Segments are written to temporary files, then appended to the recording in order as soon as each one is done.
+class Converter {
+public:
+	/// Called regularly with the frames converted so far, the frames expected in total (0 if unknown) and the time spent
+	using Progress = std::function<void(uint64_t, uint64_t, std::chrono::duration<double>)>;
+
+private:
+	/// Where a segment's decoder seeks to, and the first frame it keeps
+	struct Boundary {
+		std::chrono::microseconds seek_to, start;
+	};
+
+	struct Segment {
+		std::chrono::microseconds seek_to;
+		std::chrono::microseconds start, end; ///< Frames in [start, end) belong to the segment
+
+		FILE *data = nullptr;
+		std::vector<std::pair<std::chrono::microseconds, size_t>> frames; ///< Timestamp and size of each frame in `data`
+		std::string error;
+
+		std::promise<void> done;
+	};
+
+	const Encoder &encoder;
+	Opener open;
+	cv::Size size;
+	std::optional<int> noise_threshold;
+	size_t workers;
+
+	/// Segments per worker, more of them balances the load better at the cost of more decoders opened
+	static constexpr size_t segments_per_worker = 4;
+
+	std::atomic<uint64_t> converted = 0;
+	/// Set once a segment failed, the others stop instead of converting frames that won't be used
+	std::atomic<bool> cancelled = false;
+
+	/// Picks segment boundaries close to an even split
+	///
+	/// Seeking lands on a keyframe before the requested time, whose presentation time containers don't always tell (mp4 indexes decode times).
+	/// So the probe seeks to each split point and the first frame it decodes is taken as the boundary: the segment starting there
+	/// seeks to the same point and gets the same frame first, which makes every frame belong to exactly one segment.
+	static std::vector<Boundary> plan(Decoder &probe, size_t count) {
+		// The first segment keeps everything from the start, whatever the first timestamps are
+		std::vector<Boundary> boundaries = { Boundary{ std::chrono::microseconds(0), std::chrono::microseconds::min() } };
+
+		auto duration = probe.duration();
+		if(duration.count() <= 0 || count <= 1) return boundaries;
+
+		Frame frame;
+		for(size_t i = 1; i < count; i++) {
+			std::chrono::microseconds target = duration * i / count;
+			if(!probe.seek(target)) return { boundaries.front() };
+			if(!probe.read(frame)) break;
+
+			// Split points close together may land on the same keyframe
+			if(frame.timestamp > boundaries.back().start) boundaries.push_back(Boundary{ target, frame.timestamp });
+		}
+		return boundaries;
+	}
+
+	/// Runs on a worker
+	void convert_segment(const Source &source, Segment &segment) {
+		try {
+			auto decoder = open(source);
+			decoder->set_output_size(size);
+			decoder->set_need_color(encoder.needs_color());
+
+			if(segment.seek_to.count() > 0 && !decoder->seek(segment.seek_to)) throw DecoderError("source can't seek");
+
+			std::optional<TemporalFilter> filter;
+			if(noise_threshold.has_value()) filter.emplace(TemporalFilter::default_history, *noise_threshold, encoder.needs_color());
+
+			segment.data = std::tmpfile();
+			if(segment.data == nullptr) throw DecoderError("couldn't create a temporary file");
+
+			Frame frame;
+			std::string encoded;
+			while(!cancelled.load(std::memory_order_relaxed) && decoder->read(frame)) {
+				if(frame.timestamp < segment.start) continue;
+				if(frame.timestamp >= segment.end) break;
+
+				// Segments start on a full frame, so their deltas don't depend on the one before
+				if(filter.has_value()) encode_filtered(encoder, *filter, frame, encoded);
+				else encoder.encode(frame, encoded);
+
+				std::fwrite(encoded.data(), 1, encoded.size(), segment.data);
+				segment.frames.emplace_back(frame.timestamp, encoded.size());
+				converted++;
+			}
+		}
+		catch(DecoderError &e) {
+			segment.error = e.msg;
+		}
+		catch(cv::Exception &e) {
+			segment.error = e.what();
+		}
+
+		if(!segment.error.empty()) cancelled = true;
+		segment.done.set_value();
+	}
+
+	/// Appends a finished segment to the recording
+	static void stitch(Segment &segment, Recorder &recorder) {
+		std::rewind(segment.data);
+
+		std::string bytes;
+		for(auto [timestamp, length] : segment.frames) {
+			bytes.resize(length);
+			if(std::fread(bytes.data(), 1, length, segment.data) != length) throw DecoderError("couldn't read back a converted segment");
+
+			recorder.write(bytes, timestamp);
+		}
+
+		std::fclose(segment.data);
+		segment.data = nullptr;
+	}
+
+public:
+	/// @param size size frames are converted at
+	/// @param noise_threshold store only cells that changed, through a temporal filter with this threshold
+	/// @param workers how many segments are converted at once
+	Converter(const Encoder &encoder, Opener open, cv::Size size, std::optional<int> noise_threshold, size_t workers)
+		: encoder(encoder), open(std::move(open)), size(size), noise_threshold(noise_threshold), workers(std::max<size_t>(workers, 1)) {}
+
+	/// Converts `source` into `recorder`, the source is opened again for every segment so it has to be a regular file
+	/// @param probe a decoder already open on `source`, used to plan the segments
+	/// @param progress called about twice per second from the calling thread
+	/// @returns the number of frames converted
+	uint64_t run(const Source &source, Decoder &probe, Recorder &recorder, const Progress &progress) {
+		auto startTime = std::chrono::steady_clock::now();
+
+		Source segmentSource = source;
+		segmentSource.threads = 1; // Parallelism comes from the segments, decoders threading on top would only compete
+
+		probe.set_output_size(size);
+		probe.set_need_color(false);
+		auto boundaries = plan(probe, workers * segments_per_worker);
+
+		uint64_t expected = 0;
+		if(probe.fps() > 0.) expected = static_cast<uint64_t>(probe.duration().count() * probe.fps() / 1000000.);
+
+		std::vector<std::unique_ptr<Segment>> segments;
+		for(size_t i = 0; i < boundaries.size(); i++) {
+			auto segment = std::make_unique<Segment>();
+			segment->seek_to = boundaries[i].seek_to;
+			segment->start = boundaries[i].start;
+			segment->end = i + 1 < boundaries.size() ? boundaries[i + 1].start : std::chrono::microseconds::max();
+			segments.push_back(std::move(segment));
+		}
+
+		converted = 0;
+		cancelled = false;
+		recorder.write("\x1b[2J", std::chrono::microseconds(0));
+
+		std::optional<DecoderError> failure;
+		{
+			WorkerPool pool(workers);
+			for(auto &segment : segments) {
+				pool.submit([this, &segmentSource, segment = segment.get()]{ convert_segment(segmentSource, *segment); });
+			}
+
+			for(auto &segment : segments) {
+				auto done = segment->done.get_future();
+				while(done.wait_for(std::chrono::milliseconds(500)) != std::future_status::ready) {
+					progress(converted, expected, std::chrono::steady_clock::now() - startTime);
+				}
+
+				// Keep going after a failure so that the pool's jobs, which refer to the segments, can finish
+				if(failure.has_value()) continue;
+
+				try {
+					if(!segment->error.empty()) throw DecoderError(segment->error);
+					// A later segment failed and this one stopped short, the error is found below
+					if(cancelled) continue;
+
+					stitch(*segment, recorder);
+				}
+				catch(DecoderError &e) {
+					failure = e;
+					cancelled = true;
+				}
+			}
+		}
+
+		for(auto &segment : segments) {
+			if(segment->data != nullptr) std::fclose(segment->data);
+			if(!failure.has_value() && !segment->error.empty()) failure = DecoderError(segment->error);
+		}
+		if(failure.has_value()) throw *failure;
+
+		progress(converted, expected, std::chrono::steady_clock::now() - startTime);
+		return converted;
+	}
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+#include "errors.hpp"
+
+namespace Player {
+
+/// A decoded frame, already scaled down to the size it will be displayed at
+struct Frame {
+	cv::Mat color; ///< BGR, only filled if the decoder was told color is needed
+	cv::Mat gray;  ///< 8-bit luma
+
+	std::chrono::microseconds timestamp{0}; ///< When the frame should be shown, relative to the start of the stream
+};
+
+/// Common interface of the video backends
+class Decoder {
+public:
+	virtual ~Decoder() = default;
+
+	/// Size of the video as stored in the source, before any scaling
+	virtual cv::Size source_size() const = 0;
+
+	/// Frame rate announced by the source, 0 when it isn't known (pipes, raw streams)
+	virtual double fps() const = 0;
+
+	/// Timestamp of the last frame grabbed or read
+	virtual std::chrono::microseconds timestamp() const = 0;
+
+	/// Size frames are given at by `read`, must be set before the first frame is decoded
+	virtual void set_output_size(cv::Size size) = 0;
+
+	/// Grayscale palettes never look at `Frame::color`, backends may skip computing it
+	virtual void set_need_color(bool) {}
+
+	/// Advances by one frame without producing it, used to catch up when playback is late
+	/// @returns false at the end of the stream
+	virtual bool grab() = 0;
+
+	/// Decodes the next frame
+	/// @returns false at the end of the stream
+	virtual bool read(Frame &frame) = 0;
+
+	/// Length of the video, 0 when it isn't known
+	virtual std::chrono::microseconds duration() const { return std::chrono::microseconds(0); }
+
+	/// Moves back to the closest point decoding can start from before `timestamp`, frames before it still have to be dropped
+	/// Seeking twice to the same timestamp leads to the same first frame
+	/// @returns false if the source can't seek
+	virtual bool seek(std::chrono::microseconds) { return false; }
+};
+
+struct Source;
+
+/// Opens a decoder for a source, lets code running several decoders stay independent of the backend choice
+using Opener = std::function<std::unique_ptr<Decoder>(const Source &)>;
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "decoder.hpp"
+
+namespace Player {
+
+enum CharMode {
+	BLOCK,
+	ASCII,
+};
+
+enum ColorMode {
+	GRAYSCALE,
+	COLOR,
+	TRUE_COLOR,
+};
+
+template <typename T>
+inline T &sample_array(cv::uint8_t v, std::vector<T> &vector) {
+	return vector[ v * vector.size() / 255 ];
+}
+
+template <typename T>
+inline const T &sample_array(cv::uint8_t v, const std::vector<T> &vector) {
+	return vector[ v * vector.size() / 255 ];
+}
+
+/// Turns frames into the escape sequences drawing them
+///
+/// Holds no state besides its settings, so one encoder can be shared by threads preparing frames in advance.
+class Encoder {
+	using Transformer = void (*)(cv::uint8_t, cv::Vec3b, std::string &);
+
+	ColorMode color_mode;
+	Transformer transformer;
+
+public:
+	Encoder(CharMode chr_mode, ColorMode color_mode) : color_mode(color_mode) {
+		switch(chr_mode) {
+			case BLOCK:
+				if(color_mode == TRUE_COLOR) transformer = [](cv::uint8_t, cv::Vec3b value, std::string &buffer) {
+					buffer += fmt::format("\x1b[48;2;{};{};{}m ", value[2], value[1], value[0]);
+				};
+				else if(color_mode == COLOR) transformer = [](cv::uint8_t, cv::Vec3b value, std::string &buffer) {
+					buffer += fmt::format("\x1b[48;5;{}m ", 16 + value[0]/43 + value[1]/43*6 + value[2]/43*36);
+				};
+				else transformer = [](cv::uint8_t value, cv::Vec3b, std::string &buffer) {
+					const std::vector<const char *> blockChars = { " ", "\u2591", "\u2592", "\u2593", "\u2589" };
+
+					buffer += sample_array(value, blockChars);
+				};
+				break;
+			case ASCII:
+				if(color_mode == TRUE_COLOR) transformer = [](cv::uint8_t g, cv::Vec3b value, std::string &buffer) {
+					const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
+
+					// Boost color to max brightness to counteract character size = dimming
+					uint8_t maxValue = std::max(value[0], std::max(value[1], value[2]));
+					float diff = 255.0 / maxValue;
+					value[0] *= diff;
+					value[1] *= diff;
+					value[2] *= diff;
+
+					buffer += fmt::format("\x1b[38;2;{};{};{}m{}", value[2], value[1], value[0], sample_array(g, asciiChars));
+				};
+				else if(color_mode == COLOR) transformer = [](cv::uint8_t g, cv::Vec3b value, std::string &buffer) {
+					const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
+
+					buffer += fmt::format("\x1b[38;5;{}m{}", 16 + value[0]/43 + value[1]/43*6 + value[2]/43*36, sample_array(g, asciiChars));
+				};
+				else transformer = [](cv::uint8_t value, cv::Vec3b, std::string &buffer) {
+					const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
+
+					buffer += sample_array(value, asciiChars);
+				};
+				break;
+		}
+	}
+
+	bool needs_color() const {
+		return color_mode != GRAYSCALE;
+	}
+
+	/// Replaces the content of `out` with the whole frame drawn from the top left corner, its capacity is reused
+	void encode(const Frame &frame, std::string &out) const {
+		out.clear();
+		out += "\x1b[1;1H";
+
+		for(int j = 0; j < frame.gray.rows; j++) {
+			for(int i = 0; i < frame.gray.cols; i++) {
+				uint8_t gray = frame.gray.at<uint8_t>(j, i);
+				cv::Vec3b value = needs_color() ? frame.color.at<cv::Vec3b>(j, i) : cv::Vec3b();
+
+				transformer(gray, value, out);
+			}
+
+			out += '\n';
+		}
+
+		out += "\x1b[0m";
+	}
+
+	/// Appends the cells of `frame` where `changed` is set, or every cell if `changed` is empty, drawn with the frame's top left corner at `origin`
+	/// Only positions the cursor, colors are left as the last cell sets them
+	void append_cells(const Frame &frame, const cv::Mat &changed, cv::Point origin, std::string &out) const {
+		for(int j = 0; j < frame.gray.rows; j++) {
+			const uint8_t *mask = changed.empty() ? nullptr : changed.ptr<uint8_t>(j);
+			bool cursor_here = false; // Whether the cursor already sits on the cell, right after the previous one drawn
+
+			for(int i = 0; i < frame.gray.cols; i++) {
+				if(mask != nullptr && mask[i] == 0) {
+					cursor_here = false;
+					continue;
+				}
+
+				if(!cursor_here) out += fmt::format("\x1b[{};{}H", origin.y + j + 1, origin.x + i + 1);
+				cursor_here = true;
+
+				uint8_t gray = frame.gray.at<uint8_t>(j, i);
+				cv::Vec3b value = needs_color() ? frame.color.at<cv::Vec3b>(j, i) : cv::Vec3b();
+
+				transformer(gray, value, out);
+			}
+		}
+	}
+
+	/// Replaces the content of `out` with only the cells where `changed` is set, moving the cursor over the others
+	/// Leaves `out` empty when nothing changed
+	void encode_changes(const Frame &frame, const cv::Mat &changed, std::string &out) const {
+		out.clear();
+		append_cells(frame, changed, cv::Point(0, 0), out);
+
+		if(!out.empty()) out += "\x1b[0m";
+	}
+};
+
+}
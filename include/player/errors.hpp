@@ -0,0 +1,14 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+namespace Player {
+struct DecoderError : std::exception {
+	std::string msg;
+
+	DecoderError(std::string msg) : msg(msg) {}
+
+	const char *what() const noexcept override { return msg.c_str(); }
+};
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#ifdef AVP_USE_FFMPEG
+
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+}
+
+#include "decoder.hpp"
+#include "input.hpp"
+
+namespace Player {
+
+/// Decodes directly through libav, with control over threading, frame skipping and scaling
+///
+/// Frames are scaled straight from the decoder's native YUV to the output size, so only pixels that end up on screen are converted.
+/// The luma plane is used as is for the gray value, chroma is only scaled and converted to color when asked for.
+class FFmpegDecoder : public Decoder {
+	AVFormatContext *format = nullptr;
+	AVIOContext *io = nullptr;
+	AVCodecContext *codec = nullptr;
+	const AVCodec *av_codec = nullptr;
+	SwsContext *sws = nullptr;
+	AVPacket *packet = nullptr;
+	AVFrame *frame = nullptr;
+	int stream_index = -1;
+
+	Source source;
+	int fd = -1; ///< Only open when following a growing file, libav reads everything else itself
+
+	cv::Size output_size;
+	bool need_color = true;
+
+	/// Chroma planes at output size, luma is written straight into `Frame::gray`
+	cv::Mat u_plane, v_plane, ycrcb;
+
+	/// Input parameters `sws` was created for, and whether it outputs chroma
+	int sws_width = 0, sws_height = 0, sws_format = -1;
+	bool sws_color = false;
+
+	bool draining = false;
+	/// Frames presented up to this timestamp belong to packets that were grabbed
+	int64_t skip_until = AV_NOPTS_VALUE;
+
+	std::chrono::microseconds last_timestamp{0};
+
+	static constexpr int io_buffer_size = 1 << 16;
+
+	/// libav read callback used when following a file, waits for the writer instead of hitting the end of file
+	static int read_packet(void *opaque, uint8_t *buffer, int size) {
+		auto *self = static_cast<FFmpegDecoder *>(opaque);
+
+		ssize_t n = read_some(self->fd, buffer, size, self->source.follow);
+		if(n == 0) return AVERROR_EOF;
+		if(n < 0) return AVERROR(errno);
+		return static_cast<int>(n);
+	}
+
+	static int64_t seek(void *opaque, int64_t offset, int whence) {
+		auto *self = static_cast<FFmpegDecoder *>(opaque);
+
+		// The size keeps changing, let the demuxer treat it as unknown
+		if(whence == AVSEEK_SIZE) return -1;
+		return lseek(self->fd, offset, whence);
+	}
+
+	/// Converts a timestamp of the video stream to the time since its start
+	std::chrono::microseconds to_microseconds(int64_t pts) const {
+		auto *stream = format->streams[stream_index];
+		if(stream->start_time != AV_NOPTS_VALUE) pts -= stream->start_time;
+		return std::chrono::microseconds(av_rescale_q(pts, stream->time_base, AVRational{ 1, 1000000 }));
+	}
+
+	void set_timestamp(int64_t pts) {
+		if(pts != AV_NOPTS_VALUE) last_timestamp = to_microseconds(pts);
+	}
+
+	/// Frees everything, also used to clean up a partially constructed decoder
+	void release() {
+		sws_freeContext(sws);
+		sws = nullptr;
+		av_frame_free(&frame);
+		av_packet_free(&packet);
+		avcodec_free_context(&codec);
+		avformat_close_input(&format);
+
+		if(io != nullptr) {
+			av_freep(&io->buffer);
+			avio_context_free(&io);
+		}
+		if(fd >= 0) {
+			close_source(source, fd);
+			fd = -1;
+		}
+	}
+
+	void open_codec() {
+		if(avcodec_is_open(codec)) return;
+
+		// Decode at the smallest power of two reduction that still covers the output, for codecs supporting it
+		int lowres = 0;
+		while(
+			lowres < av_codec->max_lowres &&
+			(codec->width >> (lowres + 1)) >= output_size.width &&
+			(codec->height >> (lowres + 1)) >= output_size.height
+		) lowres++;
+		codec->lowres = lowres;
+
+		if(avcodec_open2(codec, av_codec, nullptr) < 0) throw DecoderError(fmt::format("couldn't open {} decoder", av_codec->name));
+	}
+
+	/// Hands the codec a video packet, making room for it first if its output queue is full
+	void send_packet(AVPacket *pkt) {
+		while(avcodec_send_packet(codec, pkt) == AVERROR(EAGAIN)) {
+			if(avcodec_receive_frame(codec, frame) < 0) break;
+		}
+	}
+
+	/// Feeds packets to the codec until it outputs a frame
+	/// @returns false once the stream is exhausted
+	bool decode_next() {
+		while(true) {
+			int ret = avcodec_receive_frame(codec, frame);
+			if(ret == 0) return true;
+			if(ret != AVERROR(EAGAIN) || draining) return false;
+
+			if(av_read_frame(format, packet) < 0) {
+				// End of file, flush frames still held by the codec
+				avcodec_send_packet(codec, nullptr);
+				draining = true;
+				continue;
+			}
+
+			if(packet->stream_index == stream_index) send_packet(packet);
+			av_packet_unref(packet);
+		}
+	}
+
+	void update_scaler() {
+		if(sws != nullptr && frame->width == sws_width && frame->height == sws_height && frame->format == sws_format && need_color == sws_color) return;
+
+		// Without color only the luma plane is scaled
+		sws_freeContext(sws);
+		sws = sws_getContext(
+			frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+			output_size.width, output_size.height, need_color ? AV_PIX_FMT_YUV444P : AV_PIX_FMT_GRAY8,
+			SWS_AREA, nullptr, nullptr, nullptr
+		);
+		if(sws == nullptr) throw DecoderError("couldn't create scaler");
+
+		// Output full range BT.601, which is what cv::COLOR_YCrCb2BGR expects
+		int colorspace = frame->colorspace == AVCOL_SPC_UNSPECIFIED ? SWS_CS_DEFAULT : frame->colorspace;
+		sws_setColorspaceDetails(
+			sws,
+			sws_getCoefficients(colorspace), frame->color_range == AVCOL_RANGE_JPEG,
+			sws_getCoefficients(SWS_CS_ITU601), 1,
+			0, 1 << 16, 1 << 16
+		);
+
+		sws_width = frame->width;
+		sws_height = frame->height;
+		sws_format = frame->format;
+		sws_color = need_color;
+	}
+
+public:
+	FFmpegDecoder(const Source &source) : source(source) {
+		format = avformat_alloc_context();
+
+		if(source.follow.has_value()) {
+			try {
+				fd = open_source(source);
+			}
+			catch(DecoderError &) {
+				release();
+				throw;
+			}
+			io = avio_alloc_context(static_cast<unsigned char *>(av_malloc(io_buffer_size)), io_buffer_size, 0, this, &read_packet, nullptr, &seek);
+			format->pb = io;
+			format->flags |= AVFMT_FLAG_CUSTOM_IO;
+		}
+		if(source.low_latency) format->flags |= AVFMT_FLAG_NOBUFFER;
+
+		const std::string &path = source.path;
+		if(avformat_open_input(&format, source.url().c_str(), nullptr, nullptr) < 0) {
+			release();
+			throw DecoderError(fmt::format("couldn't open \"{}\"", path));
+		}
+		if(avformat_find_stream_info(format, nullptr) < 0) {
+			release();
+			throw DecoderError(fmt::format("couldn't read stream info of \"{}\"", path));
+		}
+
+		stream_index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+		if(stream_index < 0) {
+			release();
+			throw DecoderError(fmt::format("no video stream in \"{}\"", path));
+		}
+
+		// Audio is played by mplayer, don't even demux it
+		for(unsigned int i = 0; i < format->nb_streams; i++) {
+			if(static_cast<int>(i) != stream_index) format->streams[i]->discard = AVDISCARD_ALL;
+		}
+
+		AVCodecParameters *params = format->streams[stream_index]->codecpar;
+		av_codec = avcodec_find_decoder(params->codec_id);
+		if(av_codec == nullptr) {
+			release();
+			throw DecoderError(fmt::format("no decoder for the video stream of \"{}\"", path));
+		}
+
+		codec = avcodec_alloc_context3(av_codec);
+		avcodec_parameters_to_context(codec, params);
+		codec->thread_count = source.threads; // 0 is one per core
+		if(source.low_latency) {
+			// Frame threading holds back one frame per thread
+			codec->thread_type = FF_THREAD_SLICE;
+			codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+		}
+		else {
+			codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		}
+
+		packet = av_packet_alloc();
+		frame = av_frame_alloc();
+	}
+
+	FFmpegDecoder(const FFmpegDecoder &) = delete;
+	FFmpegDecoder &operator=(const FFmpegDecoder &) = delete;
+
+	~FFmpegDecoder() override {
+		release();
+	}
+
+	cv::Size source_size() const override {
+		auto *params = format->streams[stream_index]->codecpar;
+		return cv::Size(params->width, params->height);
+	}
+
+	double fps() const override {
+		auto *stream = format->streams[stream_index];
+		AVRational rate = stream->avg_frame_rate.num != 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+		return rate.den != 0 ? av_q2d(rate) : 0.;
+	}
+
+	std::chrono::microseconds timestamp() const override {
+		return last_timestamp;
+	}
+
+	std::chrono::microseconds duration() const override {
+		auto *stream = format->streams[stream_index];
+		if(stream->duration != AV_NOPTS_VALUE) return std::chrono::microseconds(av_rescale_q(stream->duration, stream->time_base, AVRational{ 1, 1000000 }));
+		if(format->duration != AV_NOPTS_VALUE) return std::chrono::microseconds(format->duration); // Already in AV_TIME_BASE, microseconds
+
+		return std::chrono::microseconds(0);
+	}
+
+	bool seek(std::chrono::microseconds timestamp) override {
+		auto *stream = format->streams[stream_index];
+
+		int64_t pts = av_rescale_q(timestamp.count(), AVRational{ 1, 1000000 }, stream->time_base);
+		if(stream->start_time != AV_NOPTS_VALUE) pts += stream->start_time;
+		if(av_seek_frame(format, stream_index, pts, AVSEEK_FLAG_BACKWARD) < 0) return false;
+
+		if(avcodec_is_open(codec)) avcodec_flush_buffers(codec);
+		draining = false;
+		skip_until = AV_NOPTS_VALUE;
+		return true;
+	}
+
+	void set_output_size(cv::Size size) override {
+		output_size = size;
+		sws_format = -1; // Force the scaler to be recreated
+	}
+
+	void set_need_color(bool need) override {
+		need_color = need;
+	}
+
+	bool grab() override {
+		open_codec();
+
+		// Playback is late: drop non reference frames entirely and skip deblocking on the rest
+		codec->skip_frame = AVDISCARD_NONREF;
+		codec->skip_loop_filter = AVDISCARD_ALL;
+
+		// A video packet holds exactly one frame, so skipping doesn't need to wait for the codec's output
+		while(av_read_frame(format, packet) >= 0) {
+			bool is_video = packet->stream_index == stream_index;
+			if(is_video) {
+				// Streams without presentation timestamps (elementary streams) are in decode order, the decode timestamp will do
+				skip_until = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+				set_timestamp(skip_until);
+				send_packet(packet);
+			}
+			av_packet_unref(packet);
+
+			if(is_video) return true;
+		}
+		return false;
+	}
+
+	bool read(Frame &out) override {
+		open_codec();
+
+		// Keep deblocking off while catching up, restore full quality once back on time
+		codec->skip_loop_filter = skip_until != AV_NOPTS_VALUE ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+		codec->skip_frame = AVDISCARD_DEFAULT;
+
+		do {
+			if(!decode_next()) return false;
+		} while(skip_until != AV_NOPTS_VALUE && frame->best_effort_timestamp != AV_NOPTS_VALUE && frame->best_effort_timestamp <= skip_until);
+		skip_until = AV_NOPTS_VALUE;
+
+		set_timestamp(frame->best_effort_timestamp);
+		out.timestamp = last_timestamp;
+
+		update_scaler();
+
+		out.gray.create(output_size, CV_8UC1);
+		if(need_color) {
+			u_plane.create(output_size, CV_8UC1);
+			v_plane.create(output_size, CV_8UC1);
+		}
+
+		uint8_t *planes[] = { out.gray.data, u_plane.data, v_plane.data };
+		int strides[] = { static_cast<int>(out.gray.step), static_cast<int>(u_plane.step), static_cast<int>(v_plane.step) };
+		sws_scale(sws, frame->data, frame->linesize, 0, frame->height, planes, strides);
+		av_frame_unref(frame);
+
+		if(need_color) {
+			cv::merge(std::vector<cv::Mat>{ out.gray, v_plane, u_plane }, ycrcb);
+			cv::cvtColor(ycrcb, out.color, cv::COLOR_YCrCb2BGR);
+		}
+		return true;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "errors.hpp"
+
+namespace Player {
+
+/// Where frames come from
+struct Source {
+	std::string path; ///< "-" reads from stdin
+
+	/// Keep waiting for a file that is still being written, giving up after this long without new data
+	std::optional<std::chrono::milliseconds> follow;
+
+	/// Favor showing the newest frame over smooth playback
+	bool low_latency = false;
+
+	/// Threads a decoder may use, 0 for one per core
+	int threads = 0;
+
+	bool is_stdin() const { return path == "-"; }
+
+	/// Name libav and OpenCV understand for this source
+	std::string url() const { return is_stdin() ? "pipe:0" : path; }
+};
+
+/// @returns a file descriptor reading the source, stdin is shared and not owned
+inline int open_source(const Source &source) {
+	if(source.is_stdin()) return STDIN_FILENO;
+
+	int fd = ::open(source.path.c_str(), O_RDONLY);
+	if(fd < 0) throw DecoderError(fmt::format("couldn't open \"{}\": {}", source.path, std::strerror(errno)));
+	return fd;
+}
+
+inline void close_source(const Source &source, int fd) {
+	if(!source.is_stdin()) ::close(fd);
+}
+
+/// Reads at most `size` bytes, when following a file, waits for it to grow instead of reporting the end
+/// @returns the number of bytes read, 0 at the end of the stream and -1 on error
+inline ssize_t read_some(int fd, void *buffer, size_t size, std::optional<std::chrono::milliseconds> follow) {
+	auto deadline = std::chrono::steady_clock::now() + follow.value_or(std::chrono::milliseconds(0));
+
+	while(true) {
+		ssize_t n = ::read(fd, buffer, size);
+		if(n > 0) return n;
+		if(n < 0 && errno != EINTR) return -1;
+		if(n == 0 && (!follow.has_value() || std::chrono::steady_clock::now() >= deadline)) return 0;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+/// Fills `buffer` entirely
+/// @returns false if the stream ended first
+inline bool read_full(int fd, void *buffer, size_t size, std::optional<std::chrono::milliseconds> follow) {
+	auto *bytes = static_cast<char *>(buffer);
+	while(size > 0) {
+		ssize_t n = read_some(fd, bytes, size, follow);
+		if(n <= 0) return false;
+
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+}
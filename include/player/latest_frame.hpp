@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+#include "decoder.hpp"
+
+namespace Player {
+
+/// Single slot handoff between a decoding thread and the display: a new frame replaces the previous one if it wasn't shown yet
+class LatestFrame {
+	std::mutex mutex;
+	std::condition_variable updated;
+
+	Frame frame;
+	uint64_t sequence = 0;
+	bool finished = false;
+
+public:
+	/// Swaps `next` in, `next` gets back buffers that can be decoded into again
+	void publish(Frame &next) {
+		{
+			std::lock_guard lock(mutex);
+			std::swap(frame, next);
+			sequence++;
+		}
+		updated.notify_all();
+	}
+
+	/// Signals no more frames will be published
+	void finish() {
+		{
+			std::lock_guard lock(mutex);
+			finished = true;
+		}
+		updated.notify_all();
+	}
+
+	/// Waits for a frame more recent than `seen` and swaps it into `out`
+	/// @returns false once the producer finished and every frame was taken
+	bool wait_newer(uint64_t &seen, Frame &out) {
+		std::unique_lock lock(mutex);
+		updated.wait(lock, [&]{ return sequence != seen || finished; });
+
+		if(sequence == seen) return false;
+
+		std::swap(frame, out);
+		seen = sequence;
+		return true;
+	}
+};
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace Player {
+
+/// Scales a size in characters down to fit `bounds`, keeping its aspect ratio
+inline cv::Size fit_to(cv::Size size, cv::Size bounds) {
+	float fWidth = static_cast<float>(size.width);
+	float fHeight = static_cast<float>(size.height);
+
+	if(fHeight > bounds.height) {
+		fHeight = bounds.height;
+
+		fWidth = fWidth / ( ( fWidth / fHeight ) / ( static_cast<float>( size.width ) / size.height ) );
+	}
+
+	if(fWidth > bounds.width) {
+		fWidth = bounds.width;
+
+		fHeight = fHeight * ( ( fWidth / fHeight ) / ( static_cast<float>( size.width ) / size.height ) );
+	}
+
+	// Truncate towards zero
+	return cv::Size(static_cast<int>(fWidth), static_cast<int>(fHeight));
+}
+
+/// Size in characters a video of `source` pixels is shown at within `bounds`
+inline cv::Size fit_cells(cv::Size source, cv::Size bounds) {
+	// Characters are about twice as tall as they are wide
+	source.height /= 2;
+	return fit_to(source, bounds);
+}
+
+/// Splits `area` in a grid of `count` cells, as square as the count allows, filled row by row
+inline std::vector<cv::Rect> grid_layout(size_t count, cv::Size area) {
+	std::vector<cv::Rect> cells;
+	if(count == 0) return cells;
+
+	int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+	int rows = static_cast<int>((count + columns - 1) / columns);
+
+	for(size_t i = 0; i < count; i++) {
+		int column = static_cast<int>(i) % columns;
+		int row = static_cast<int>(i) / columns;
+
+		int x = column * area.width / columns;
+		int y = row * area.height / rows;
+		cells.emplace_back(x, y, (column + 1) * area.width / columns - x, (row + 1) * area.height / rows - y);
+	}
+	return cells;
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+
+#include <fmt/core.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include "decoder.hpp"
+#include "input.hpp"
+
+namespace Player {
+
+/// Decodes through cv::VideoCapture, always available but decodes and converts the full resolution BGR image
+class OpenCVDecoder : public Decoder {
+	cv::VideoCapture cap;
+	cv::Size output_size;
+	cv::Mat source;
+
+	int64_t frame_count = 0;
+	std::chrono::microseconds last_timestamp{0};
+
+	void update_timestamp() {
+		frame_count++;
+
+		// Streams opened from a pipe don't always report a position, count frames instead
+		double ms = cap.get(cv::CAP_PROP_POS_MSEC);
+		if(ms <= 0. && fps() > 0.) ms = 1000. * (frame_count - 1) / fps();
+
+		last_timestamp = std::chrono::microseconds(static_cast<int64_t>(ms * 1000.));
+	}
+
+public:
+	OpenCVDecoder(const Source &source) : cap(source.url()) {
+		if(source.follow.has_value()) throw DecoderError("following a growing file needs the ffmpeg decoder");
+		if(!cap.isOpened()) throw DecoderError(fmt::format("couldn't open \"{}\"", source.path));
+	}
+
+	cv::Size source_size() const override {
+		return cv::Size(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+	}
+
+	double fps() const override {
+		return cap.get(cv::CAP_PROP_FPS);
+	}
+
+	std::chrono::microseconds timestamp() const override {
+		return last_timestamp;
+	}
+
+	std::chrono::microseconds duration() const override {
+		double frames = cap.get(cv::CAP_PROP_FRAME_COUNT);
+		if(frames <= 0. || fps() <= 0.) return std::chrono::microseconds(0);
+
+		return std::chrono::microseconds(static_cast<int64_t>(1000000. * frames / fps()));
+	}
+
+	bool seek(std::chrono::microseconds timestamp) override {
+		if(!cap.set(cv::CAP_PROP_POS_MSEC, timestamp.count() / 1000.)) return false;
+
+		// Keep counting frames from the right place for streams without positions
+		frame_count = fps() > 0. ? static_cast<int64_t>(timestamp.count() * fps() / 1000000.) : 0;
+		return true;
+	}
+
+	void set_output_size(cv::Size size) override {
+		output_size = size;
+	}
+
+	bool grab() override {
+		if(!cap.grab()) return false;
+
+		update_timestamp();
+		return true;
+	}
+
+	bool read(Frame &frame) override {
+		if(!cap.read(source)) return false;
+
+		update_timestamp();
+		frame.timestamp = last_timestamp;
+
+		cv::resize(source, frame.color, output_size, 0., 0., cv::INTER_AREA);
+		cv::cvtColor(frame.color, frame.gray, cv::COLOR_BGR2GRAY);
+		return true;
+	}
+};
+
+}
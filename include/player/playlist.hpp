@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "errors.hpp"
+
+namespace Player {
+
+/// Ordered list of videos to play, built from files, directories and playlist files
+class Playlist {
+	std::vector<std::string> items;
+	size_t position = 0;
+
+	bool loop, shuffle;
+	std::mt19937 random{ std::random_device{}() };
+
+	static bool is_video(const std::filesystem::path &path) {
+		static const std::array<std::string, 14> extensions = {
+			".mp4", ".mkv", ".webm", ".avi", ".mov", ".m4v", ".ts", ".flv", ".wmv", ".mpg", ".mpeg", ".gif", ".ogv", ".3gp"
+		};
+
+		std::string extension = path.extension().string();
+		std::ranges::transform(extension, extension.begin(), [](unsigned char c){ return std::tolower(c); });
+		return std::ranges::find(extensions, extension) != extensions.end();
+	}
+
+public:
+	Playlist(bool loop, bool shuffle) : loop(loop), shuffle(shuffle) {}
+
+	/// Adds a video, every video of a directory (sorted by name), or "-" for stdin
+	void add(const std::string &path) {
+		namespace fs = std::filesystem;
+
+		if(path != "-" && fs::is_directory(path)) {
+			std::vector<std::string> found;
+			for(auto &entry : fs::directory_iterator(path)) {
+				if(entry.is_regular_file() && is_video(entry.path())) found.push_back(entry.path().string());
+			}
+			std::ranges::sort(found);
+
+			items.insert(items.end(), found.begin(), found.end());
+		}
+		else {
+			items.push_back(path);
+		}
+	}
+
+	/// Adds every entry of a playlist file: one path per line, relative to the playlist, with '#' comments (which covers .m3u)
+	void add_playlist(const std::string &path) {
+		namespace fs = std::filesystem;
+
+		std::ifstream file(path);
+		if(!file) throw DecoderError(fmt::format("couldn't open playlist \"{}\"", path));
+
+		fs::path base = fs::path(path).parent_path();
+		std::string line;
+		while(std::getline(file, line)) {
+			if(!line.empty() && line.back() == '\r') line.pop_back();
+			if(line.empty() || line.front() == '#') continue;
+
+			fs::path entry(line);
+			add(line != "-" && entry.is_relative() ? (base / entry).string() : line);
+		}
+	}
+
+	size_t size() const {
+		return items.size();
+	}
+
+	/// Whether one of the videos is read from stdin, which then can't be used for anything else
+	bool reads_stdin() const {
+		return std::ranges::find(items, "-") != items.end();
+	}
+
+	/// @returns the next video to play, nullopt at the end of the list if it isn't looping
+	std::optional<std::string> next() {
+		if(items.empty()) return std::nullopt;
+
+		if(position == items.size()) {
+			if(!loop) return std::nullopt;
+			position = 0;
+		}
+		// Shuffle on every pass, so that looping doesn't repeat the same order
+		if(position == 0 && shuffle) std::ranges::shuffle(items, random);
+
+		return items[position++];
+	}
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "input.hpp"
+#include "temporal.hpp"
+
+namespace Player {
+
+/// A frame ready to be written to the terminal
+struct EncodedFrame {
+	std::string text;
+	std::chrono::microseconds timestamp{0};
+};
+
+/// A video opened ahead of time, with its first frames already decoded and encoded
+struct PreparedVideo {
+	Source source;
+	std::unique_ptr<Decoder> decoder;
+	cv::Size size; ///< Output size the decoder was set to
+
+	/// Set when only cells that really changed are redrawn, carries what is on screen from one frame to the next
+	std::optional<TemporalFilter> filter;
+
+	std::vector<EncodedFrame> frames;
+	bool finished = false; ///< The video ended while prefetching, `frames` is all there is
+
+	/// Encodes the next frame to show, through the temporal filter when there is one
+	void encode(const Encoder &encoder, const Frame &frame, std::string &out) {
+		if(!filter.has_value()) return encoder.encode(frame, out);
+		encode_filtered(encoder, *filter, frame, out);
+	}
+};
+
+/// Decodes and encodes the first `count` frames of `video`
+/// @param spare frames from a previous video, their strings' capacity is reused
+inline void prefetch(PreparedVideo &video, const Encoder &encoder, size_t count, std::vector<EncodedFrame> &&spare) {
+	video.frames = std::move(spare);
+	video.frames.resize(count);
+
+	Frame frame;
+	for(size_t i = 0; i < count; i++) {
+		if(!video.decoder->read(frame)) {
+			video.frames.resize(i);
+			video.finished = true;
+			return;
+		}
+
+		video.encode(encoder, frame, video.frames[i].text);
+		video.frames[i].timestamp = frame.timestamp;
+	}
+}
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <chrono>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "decoder.hpp"
+#include "input.hpp"
+
+namespace Player {
+
+/// Layout of uncompressed frames, as given by `ffmpeg -f rawvideo -pix_fmt ...`
+struct RawFormat {
+	enum PixelFormat {
+		GRAY,
+		BGR24,
+		RGB24,
+		YUV420P,
+	};
+
+	cv::Size size;
+	PixelFormat pixel_format = BGR24;
+	double fps = 0.; ///< 0 to time frames by when they arrive
+
+	/// @param size "{width}x{height}"
+	/// @param pixel_format ffmpeg name of the pixel format
+	static RawFormat parse(std::string_view size, std::string_view pixel_format, double fps) {
+		RawFormat format;
+		format.fps = fps;
+
+		auto separator = size.find('x');
+		if(separator == std::string_view::npos) throw DecoderError(fmt::format("invalid raw frame size \"{}\", expected {{width}}x{{height}}", size));
+
+		auto parse_int = [&](std::string_view str) {
+			int value = 0;
+			auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+			if(ec != std::errc() || ptr != str.data() + str.size() || value <= 0) throw DecoderError(fmt::format("invalid raw frame size \"{}\"", size));
+			return value;
+		};
+		format.size = cv::Size(parse_int(size.substr(0, separator)), parse_int(size.substr(separator + 1)));
+
+		if(pixel_format == "gray") format.pixel_format = GRAY;
+		else if(pixel_format == "bgr24") format.pixel_format = BGR24;
+		else if(pixel_format == "rgb24") format.pixel_format = RGB24;
+		else if(pixel_format == "yuv420p") format.pixel_format = YUV420P;
+		else throw DecoderError(fmt::format("unsupported raw pixel format \"{}\", expected gray, bgr24, rgb24 or yuv420p", pixel_format));
+
+		if(format.pixel_format == YUV420P && (format.size.width % 2 != 0 || format.size.height % 2 != 0)) throw DecoderError("yuv420p frames need an even size");
+
+		return format;
+	}
+
+	size_t frame_bytes() const {
+		size_t pixels = static_cast<size_t>(size.width) * size.height;
+		switch(pixel_format) {
+			case GRAY: return pixels;
+			case BGR24:
+			case RGB24: return pixels * 3;
+			case YUV420P: return pixels * 3 / 2;
+		}
+		return pixels;
+	}
+};
+
+/// Reads a headerless stream of fixed size frames from a file, a pipe or stdin
+class RawDecoder : public Decoder {
+	Source source;
+	RawFormat format;
+	int fd;
+
+	std::vector<uint8_t> buffer;
+	cv::Mat converted;
+	cv::Mat u_plane, v_plane, yuv;
+
+	/// BT.601 limited range YUV to BGR, as cv::COLOR_YUV2BGR_I420 does
+	static inline const cv::Matx34f yuv_to_bgr{
+		1.164f, 2.018f, 0.f, -1.164f * 16.f - 2.018f * 128.f,
+		1.164f, -0.391f, -0.813f, -1.164f * 16.f + (0.391f + 0.813f) * 128.f,
+		1.164f, 0.f, 1.596f, -1.164f * 16.f - 1.596f * 128.f,
+	};
+
+	cv::Size output_size;
+	bool need_color = true;
+
+	int64_t frame_count = 0;
+	std::chrono::steady_clock::time_point first_arrival;
+	std::chrono::microseconds last_timestamp{0};
+
+	bool next_frame() {
+		if(!read_full(fd, buffer.data(), buffer.size(), source.follow)) return false;
+
+		if(format.fps > 0.) {
+			last_timestamp = std::chrono::microseconds(static_cast<int64_t>(1000000. * frame_count / format.fps));
+		}
+		else {
+			// No clock in the stream, a frame is due as soon as it is there
+			auto arrival = std::chrono::steady_clock::now();
+			if(frame_count == 0) first_arrival = arrival;
+			last_timestamp = std::chrono::duration_cast<std::chrono::microseconds>(arrival - first_arrival);
+		}
+
+		frame_count++;
+		return true;
+	}
+
+public:
+	RawDecoder(const Source &source, RawFormat format) : source(source), format(format), buffer(format.frame_bytes()) {
+		fd = open_source(source);
+	}
+
+	RawDecoder(const RawDecoder &) = delete;
+	RawDecoder &operator=(const RawDecoder &) = delete;
+
+	~RawDecoder() override {
+		close_source(source, fd);
+	}
+
+	cv::Size source_size() const override {
+		return format.size;
+	}
+
+	double fps() const override {
+		return format.fps;
+	}
+
+	std::chrono::microseconds timestamp() const override {
+		return last_timestamp;
+	}
+
+	void set_output_size(cv::Size size) override {
+		output_size = size;
+	}
+
+	void set_need_color(bool need) override {
+		need_color = need;
+	}
+
+	bool grab() override {
+		return next_frame();
+	}
+
+	bool read(Frame &frame) override {
+		if(!next_frame()) return false;
+		frame.timestamp = last_timestamp;
+
+		switch(format.pixel_format) {
+			case RawFormat::GRAY: {
+				cv::resize(cv::Mat(format.size, CV_8UC1, buffer.data()), frame.gray, output_size, 0., 0., cv::INTER_AREA);
+				if(need_color) cv::cvtColor(frame.gray, frame.color, cv::COLOR_GRAY2BGR);
+				break;
+			}
+			case RawFormat::BGR24: {
+				cv::resize(cv::Mat(format.size, CV_8UC3, buffer.data()), frame.color, output_size, 0., 0., cv::INTER_AREA);
+				cv::cvtColor(frame.color, frame.gray, cv::COLOR_BGR2GRAY);
+				break;
+			}
+			case RawFormat::RGB24: {
+				cv::resize(cv::Mat(format.size, CV_8UC3, buffer.data()), converted, output_size, 0., 0., cv::INTER_AREA);
+				cv::cvtColor(converted, frame.color, cv::COLOR_RGB2BGR);
+				cv::cvtColor(frame.color, frame.gray, cv::COLOR_BGR2GRAY);
+				break;
+			}
+			case RawFormat::YUV420P: {
+				// The luma plane comes first and is the gray value as is
+				cv::resize(cv::Mat(format.size, CV_8UC1, buffer.data()), frame.gray, output_size, 0., 0., cv::INTER_AREA);
+				if(need_color) {
+					// Chroma planes follow at half the size, they are scaled down first so that only output pixels are converted
+					cv::Size chroma_size(format.size.width / 2, format.size.height / 2);
+					uint8_t *u = buffer.data() + format.size.area();
+					uint8_t *v = u + chroma_size.area();
+					cv::resize(cv::Mat(chroma_size, CV_8UC1, u), u_plane, output_size, 0., 0., cv::INTER_AREA);
+					cv::resize(cv::Mat(chroma_size, CV_8UC1, v), v_plane, output_size, 0., 0., cv::INTER_AREA);
+
+					cv::merge(std::vector<cv::Mat>{ frame.gray, u_plane, v_plane }, yuv);
+					cv::transform(yuv, frame.color, yuv_to_bgr);
+				}
+				break;
+			}
+		}
+		return true;
+	}
+};
+
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+namespace Player {
+
+struct RecordingError : std::exception {
+	std::string msg;
+
+	RecordingError(std::string msg) : msg(msg) {}
+
+	const char *what() const noexcept override { return msg.c_str(); }
+};
+
+/// On disk layout of a recording, in host byte order:
+/// the header, every frame as a frame header followed by the bytes written to the terminal, then the index of the frames.
+/// The index is only written when the recording is closed, without it the frames are walked through to rebuild it.
+namespace RecordingFormat {
+	constexpr char magic[8] = { 'A', 'V', 'P', 'R', 'E', 'C', '\0', '\0' };
+	constexpr uint32_t version = 2;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t columns, rows; ///< Terminal size at recording time
+		uint32_t reserved;
+		uint64_t frame_count;
+		uint64_t index_offset; ///< 0 if the recording wasn't closed properly, aligned for IndexEntry otherwise
+	};
+
+	/// Precedes the bytes of every frame, which may not be aligned
+	struct FrameHeader {
+		int64_t timestamp;
+		uint64_t size;
+	};
+
+	struct IndexEntry {
+		int64_t timestamp; ///< Microseconds since the start of the recording
+		uint64_t offset; ///< Of the frame's bytes, past its frame header
+		uint64_t size;
+	};
+
+	static_assert(sizeof(Header) == 40);
+	static_assert(sizeof(FrameHeader) == 16);
+	static_assert(sizeof(IndexEntry) == 24);
+}
+
+/// Captures what is written to the terminal, with when it was written
+///
+/// Every frame is flushed as it is written, so a recording cut short by Ctrl-C or a crash still holds all but the last frame.
+class Recorder {
+	FILE *file;
+	RecordingFormat::Header header{};
+	std::vector<RecordingFormat::IndexEntry> index;
+	uint64_t offset = sizeof(RecordingFormat::Header);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	void write_header() {
+		std::fseek(file, 0, SEEK_SET);
+		std::fwrite(&header, sizeof(header), 1, file);
+	}
+
+public:
+	Recorder(const std::string &path, uint32_t columns, uint32_t rows) : file(std::fopen(path.c_str(), "wb")) {
+		if(file == nullptr) throw RecordingError(fmt::format("couldn't create recording \"{}\": {}", path, std::strerror(errno)));
+
+		std::memcpy(header.magic, RecordingFormat::magic, sizeof(header.magic));
+		header.version = RecordingFormat::version;
+		header.columns = columns;
+		header.rows = rows;
+		write_header();
+	}
+
+	Recorder(const Recorder &) = delete;
+	Recorder &operator=(const Recorder &) = delete;
+
+	~Recorder() {
+		close();
+	}
+
+	/// Appends what was just written to the terminal, timestamped now
+	void write(std::string_view bytes) {
+		auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		write(bytes, now);
+	}
+
+	void write(std::string_view bytes, std::chrono::microseconds timestamp) {
+		if(file == nullptr || bytes.empty()) return;
+
+		RecordingFormat::FrameHeader frame{ timestamp.count(), bytes.size() };
+		std::fwrite(&frame, sizeof(frame), 1, file);
+		std::fwrite(bytes.data(), 1, bytes.size(), file);
+		std::fflush(file);
+
+		offset += sizeof(frame);
+		index.push_back(RecordingFormat::IndexEntry{ timestamp.count(), offset, bytes.size() });
+		offset += bytes.size();
+	}
+
+	/// Writes the index, frames written afterwards are ignored
+	void close() {
+		if(file == nullptr) return;
+
+		// Frames have any size, pad so that the index can be read in place
+		constexpr size_t alignment = alignof(RecordingFormat::IndexEntry);
+		const char padding[alignment] = {};
+		size_t padding_size = (alignment - offset % alignment) % alignment;
+		std::fwrite(padding, 1, padding_size, file);
+		offset += padding_size;
+
+		std::fwrite(index.data(), sizeof(RecordingFormat::IndexEntry), index.size(), file);
+		std::fflush(file);
+		header.frame_count = index.size();
+		header.index_offset = offset;
+		write_header();
+
+		std::fclose(file);
+		file = nullptr;
+	}
+};
+
+/// A recording mapped in memory, frames are read in place
+class Recording {
+	const char *data = nullptr;
+	size_t length = 0;
+
+	const RecordingFormat::Header *header;
+	const RecordingFormat::IndexEntry *index = nullptr;
+	size_t count = 0;
+
+	/// Index of a recording that wasn't closed properly, rebuilt from its frame headers
+	std::vector<RecordingFormat::IndexEntry> rebuilt;
+
+	/// Walks through the frames, up to the last one written entirely
+	void rebuild_index() {
+		size_t offset = sizeof(RecordingFormat::Header);
+		while(length - offset >= sizeof(RecordingFormat::FrameHeader)) {
+			RecordingFormat::FrameHeader frame;
+			std::memcpy(&frame, data + offset, sizeof(frame));
+			offset += sizeof(frame);
+
+			if(frame.size > length - offset) break;
+			rebuilt.push_back(RecordingFormat::IndexEntry{ frame.timestamp, offset, frame.size });
+			offset += frame.size;
+		}
+
+		index = rebuilt.data();
+		count = rebuilt.size();
+	}
+
+	/// @returns whether every entry of the index points inside the frames
+	bool index_valid() const {
+		for(size_t i = 0; i < count; i++) {
+			const auto &entry = index[i];
+			if(entry.offset < sizeof(RecordingFormat::Header) || entry.offset > header->index_offset || entry.size > header->index_offset - entry.offset) return false;
+		}
+		return true;
+	}
+
+public:
+	struct Frame {
+		std::chrono::microseconds timestamp;
+		std::string_view bytes;
+	};
+
+	Recording(const std::string &path) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) throw RecordingError(fmt::format("couldn't open recording \"{}\": {}", path, std::strerror(errno)));
+
+		struct stat info;
+		if(fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(RecordingFormat::Header)) {
+			::close(fd);
+			throw RecordingError(fmt::format("\"{}\" is not a recording", path));
+		}
+		length = info.st_size;
+
+		void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if(mapped == MAP_FAILED) throw RecordingError(fmt::format("couldn't map recording \"{}\": {}", path, std::strerror(errno)));
+		data = static_cast<const char *>(mapped);
+
+		header = reinterpret_cast<const RecordingFormat::Header *>(data);
+
+		const char *error = nullptr;
+		if(std::memcmp(header->magic, RecordingFormat::magic, sizeof(header->magic)) != 0) error = "is not a recording";
+		else if(header->version != RecordingFormat::version) error = "was made by another version";
+		else if(header->index_offset == 0) rebuild_index();
+		else if(header->index_offset % alignof(RecordingFormat::IndexEntry) != 0 || header->index_offset > length) error = "is corrupted";
+		else if(header->frame_count > (length - header->index_offset) / sizeof(RecordingFormat::IndexEntry)) error = "is truncated";
+		else {
+			index = reinterpret_cast<const RecordingFormat::IndexEntry *>(data + header->index_offset);
+			count = header->frame_count;
+			if(!index_valid()) error = "is corrupted";
+		}
+
+		if(error != nullptr) {
+			munmap(const_cast<char *>(data), length);
+			throw RecordingError(fmt::format("\"{}\" {}", path, error));
+		}
+	}
+
+	Recording(const Recording &) = delete;
+	Recording &operator=(const Recording &) = delete;
+
+	~Recording() {
+		munmap(const_cast<char *>(data), length);
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	uint32_t columns() const {
+		return header->columns;
+	}
+
+	uint32_t rows() const {
+		return header->rows;
+	}
+
+	Frame operator[](size_t i) const {
+		const auto &entry = index[i];
+		return Frame{ std::chrono::microseconds(entry.timestamp), std::string_view(data + entry.offset, entry.size) };
+	}
+};
+
+/// Writes a recording as an asciicast v2 file, which asciinema and most web players read
+inline void write_asciicast(const Recording &recording, FILE *output) {
+	fmt::print(output, "{{\"version\": 2, \"width\": {}, \"height\": {}}}\n", recording.columns(), recording.rows());
+
+	std::string escaped;
+	for(size_t i = 0; i < recording.size(); i++) {
+		auto frame = recording[i];
+
+		escaped.clear();
+		for(char c : frame.bytes) {
+			switch(c) {
+				case '"': escaped += "\\\""; break;
+				case '\\': escaped += "\\\\"; break;
+				case '\n': escaped += "\\r\\n"; break; // What the terminal driver turns newlines into
+				case '\r': escaped += "\\r"; break;
+				case '\t': escaped += "\\t"; break;
+				default:
+					if(static_cast<unsigned char>(c) < 0x20) escaped += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+					else escaped += c; // UTF-8 passes through
+			}
+		}
+
+		fmt::print(output, "[{:.6f}, \"o\", \"{}\"]\n", frame.timestamp.count() / 1e6, escaped);
+	}
+}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+
+namespace Player {
+
+/// Looks across frames: holds back cell changes too small to be more than noise, and spots scene cuts
+///
+/// What is on screen only follows the video once a cell drifts away from it by more than a threshold,
+/// so grain and dithering don't make glyphs and colors flicker. The mean difference between consecutive
+/// frames is compared with the recent ones kept in a ring to tell cuts, which redraw everything, from motion.
+class TemporalFilter {
+	int gray_threshold;
+	int color_threshold;
+	bool use_color;
+
+	/// The last gray frame seen, only the differences are looked back at further
+	cv::Mat previous;
+	/// Ring of the recent frames' mean difference with the frame before them
+	std::vector<double> differences;
+	size_t head = 0, count = 0;
+
+	Frame shown;
+	cv::Mat changed_mask;
+	bool cut = true;
+
+	/// Any mean difference above this is a cut, whatever the recent motion
+	static constexpr double hard_cut = 48.;
+	/// Below this, differences are motion, however still the recent frames were
+	static constexpr double soft_cut = 16.;
+	/// A jump of this many times the recent mean difference is a cut
+	static constexpr double cut_ratio = 4.;
+
+	bool detect_cut(const cv::Mat &gray) {
+		if(count == 0 || previous.size() != gray.size()) return true;
+
+		double difference = cv::norm(gray, previous, cv::NORM_L1) / gray.total();
+		differences[head] = difference;
+
+		// The first frame seen has no difference to go with it
+		size_t history = std::min(count - 1, differences.size() - 1);
+		if(history == 0) return difference > hard_cut;
+
+		double recent = 0.;
+		for(size_t i = 1; i <= history; i++) recent += differences[(head + differences.size() - i) % differences.size()];
+		recent /= history;
+
+		return difference > hard_cut || (difference > soft_cut && difference > cut_ratio * recent);
+	}
+
+public:
+	/// Frames looked back at to tell scene cuts from motion
+	static constexpr size_t default_history = 8;
+
+	/// @param history frames whose differences cuts are judged against
+	/// @param gray_threshold how far a cell's gray value has to move before it is redrawn
+	/// @param use_color whether colors are shown and have to be followed too, with twice the threshold summed over channels
+	TemporalFilter(size_t history, int gray_threshold, bool use_color)
+		: gray_threshold(gray_threshold), color_threshold(gray_threshold * 2), use_color(use_color), differences(std::max<size_t>(history, 2), 0.) {}
+
+	/// Forgets every frame seen, the next one is drawn in full
+	void reset() {
+		count = 0;
+		head = 0;
+		cut = true;
+	}
+
+	/// Folds the next frame into what is shown
+	void update(const Frame &frame) {
+		cut = detect_cut(frame.gray);
+
+		frame.gray.copyTo(previous);
+		head = (head + 1) % differences.size();
+		count++;
+
+		shown.timestamp = frame.timestamp;
+
+		if(cut) {
+			frame.gray.copyTo(shown.gray);
+			if(use_color) frame.color.copyTo(shown.color);
+
+			changed_mask.create(frame.gray.size(), CV_8UC1);
+			changed_mask.setTo(cv::Scalar(255));
+			return;
+		}
+
+		for(int j = 0; j < frame.gray.rows; j++) {
+			const uint8_t *gray = frame.gray.ptr<uint8_t>(j);
+			const cv::Vec3b *color = use_color ? frame.color.ptr<cv::Vec3b>(j) : nullptr;
+			uint8_t *shown_gray = shown.gray.ptr<uint8_t>(j);
+			cv::Vec3b *shown_color = use_color ? shown.color.ptr<cv::Vec3b>(j) : nullptr;
+			uint8_t *changed = changed_mask.ptr<uint8_t>(j);
+
+			for(int i = 0; i < frame.gray.cols; i++) {
+				bool moved = std::abs(gray[i] - shown_gray[i]) > gray_threshold;
+				if(use_color && !moved) {
+					int distance = std::abs(color[i][0] - shown_color[i][0]) + std::abs(color[i][1] - shown_color[i][1]) + std::abs(color[i][2] - shown_color[i][2]);
+					moved = distance > color_threshold;
+				}
+
+				changed[i] = moved ? 255 : 0;
+				if(moved) {
+					shown_gray[i] = gray[i];
+					if(use_color) shown_color[i] = color[i];
+				}
+			}
+		}
+	}
+
+	/// What should be on screen after the last update
+	const Frame &frame() const {
+		return shown;
+	}
+
+	/// 255 for the cells that differ from the previous update, every cell after a cut
+	const cv::Mat &changed() const {
+		return changed_mask;
+	}
+
+	/// Whether the last update was a scene cut (or the first frame), which redraws everything
+	bool scene_cut() const {
+		return cut;
+	}
+};
+
+/// Folds `frame` into `filter` and encodes what to write: the whole frame after a scene cut, only the cells that changed otherwise
+inline void encode_filtered(const Encoder &encoder, TemporalFilter &filter, const Frame &frame, std::string &out) {
+	filter.update(frame);
+	if(filter.scene_cut()) encoder.encode(filter.frame(), out);
+	else encoder.encode_changes(filter.frame(), filter.changed(), out);
+}
+
+/// Same as encode_filtered() for a frame drawn in part of the screen, appending its cells at `origin`
+inline void append_filtered(const Encoder &encoder, TemporalFilter &filter, const Frame &frame, cv::Point origin, std::string &out) {
+	filter.update(frame);
+	encoder.append_cells(filter.frame(), filter.scene_cut() ? cv::Mat() : filter.changed(), origin, out);
+}
+
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "decoder.hpp"
+#include "encoder.hpp"
+#include "input.hpp"
+#include "layout.hpp"
+#include "temporal.hpp"
+#include "worker_pool.hpp"
+
+namespace Player {
+
+/// Several videos tiled in one terminal
+///
+/// Tiles are decoded on a shared worker pool, each at its own frame rate, one frame ahead of when it is due.
+/// A single scheduler wakes up at a fixed refresh rate, draws the tiles whose frame is due and writes them all at once.
+class Wall {
+public:
+	using Presenter = std::function<void(const std::string &)>;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Tile {
+		Source source;
+		std::unique_ptr<Decoder> decoder;
+
+		cv::Point origin; ///< Terminal cell of the video's top left corner
+		cv::Size size; ///< Cells the video takes
+		std::optional<TemporalFilter> filter;
+
+		/// When the frame with timestamp 0 is due, set by the first frame shown
+		Clock::time_point start;
+		bool started = false;
+		std::chrono::microseconds frame_delay{40000};
+
+		/// Decoded ahead by a worker, waiting to be due
+		Frame ready;
+		bool has_ready = false;
+		bool ended = false;
+		std::string error;
+
+		/// Set while a worker owns the tile, everything above is only touched by whoever owns it
+		std::atomic<bool> busy = false;
+	};
+
+	const Encoder &encoder;
+	Opener open;
+	std::optional<int> noise_threshold;
+	bool loop;
+	std::chrono::microseconds refresh;
+
+	std::vector<std::unique_ptr<Tile>> tiles;
+	WorkerPool pool;
+
+	/// Runs on a worker: decodes the tile's next frame, dropping the ones it is already too late for
+	void decode(Tile &tile) {
+		try {
+			if(tile.started) {
+				auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - tile.start);
+				while(tile.decoder->timestamp() + 2 * tile.frame_delay < elapsed) {
+					if(!tile.decoder->grab()) break;
+				}
+			}
+
+			if(tile.decoder->read(tile.ready)) {
+				tile.has_ready = true;
+			}
+			else if(loop) {
+				// Start over with a fresh decoder and clock
+				tile.decoder = open(tile.source);
+				tile.decoder->set_output_size(tile.size);
+				tile.decoder->set_need_color(encoder.needs_color());
+
+				tile.started = false;
+				if(tile.filter.has_value()) tile.filter->reset(); // The new start is drawn in full, not against the old end
+				tile.has_ready = tile.decoder->read(tile.ready);
+				tile.ended = !tile.has_ready;
+			}
+			else {
+				tile.ended = true;
+			}
+		}
+		catch(DecoderError &e) {
+			tile.error = e.msg;
+			tile.ended = true;
+		}
+		catch(cv::Exception &e) {
+			// Would otherwise escape the worker thread and end the program
+			tile.error = e.what();
+			tile.ended = true;
+		}
+
+		tile.busy.store(false, std::memory_order_release);
+	}
+
+	void draw(Tile &tile, std::string &out) {
+		if(!tile.filter.has_value()) return encoder.append_cells(tile.ready, cv::Mat(), tile.origin, out);
+
+		append_filtered(encoder, *tile.filter, tile.ready, tile.origin, out);
+	}
+
+public:
+	/// @param noise_threshold redraw only cells that changed, through a temporal filter with this threshold
+	/// @param loop restart each video when it ends, the wall then plays until interrupted
+	/// @param refresh_rate how many times per second the terminal is updated
+	Wall(const Encoder &encoder, Opener open, std::optional<int> noise_threshold, bool loop, double refresh_rate)
+		: encoder(encoder), open(std::move(open)), noise_threshold(noise_threshold), loop(loop),
+		refresh(static_cast<int64_t>(1000000. / refresh_rate)) {}
+
+	/// Opens the video of a tile, tiles are laid out in the order they are added
+	void add(const Source &source) {
+		auto tile = std::make_unique<Tile>();
+		tile->source = source;
+		tile->source.threads = 1; // Tiles already decode in parallel on the pool, decoders threading on top would only compete
+		tile->decoder = open(source);
+		if(tile->decoder->fps() > 0.) tile->frame_delay = std::chrono::microseconds(static_cast<int64_t>(1000000. / tile->decoder->fps()));
+		if(noise_threshold.has_value()) tile->filter.emplace(TemporalFilter::default_history, *noise_threshold, encoder.needs_color());
+
+		tiles.push_back(std::move(tile));
+	}
+
+	size_t size() const {
+		return tiles.size();
+	}
+
+	/// Plays every tile until they all ended
+	/// @param area terminal cells the wall takes
+	/// @param present writes one refresh worth of output to the terminal
+	/// @returns errors that stopped tiles early
+	std::vector<std::string> run(cv::Size area, const Presenter &present) {
+		auto cells = grid_layout(tiles.size(), area);
+		for(size_t i = 0; i < tiles.size(); i++) {
+			Tile &tile = *tiles[i];
+
+			cv::Size size = fit_cells(tile.decoder->source_size(), cells[i].size());
+			tile.size = size;
+			if(size.width < 1 || size.height < 1) {
+				tile.error = fmt::format("no room left for it on a {}x{} terminal", area.width, area.height);
+				tile.ended = true;
+				continue;
+			}
+
+			tile.origin = cells[i].tl() + cv::Point((cells[i].width - size.width) / 2, (cells[i].height - size.height) / 2);
+			tile.decoder->set_output_size(size);
+			tile.decoder->set_need_color(encoder.needs_color());
+		}
+
+		std::string out;
+		auto next_tick = Clock::now();
+		while(true) {
+			bool playing = false;
+			auto now = Clock::now();
+
+			out.clear();
+			for(auto &tile_ptr : tiles) {
+				Tile &tile = *tile_ptr;
+
+				if(tile.busy.load(std::memory_order_acquire)) {
+					playing = true;
+					continue;
+				}
+
+				if(tile.has_ready) {
+					if(!tile.started) {
+						tile.start = now - tile.ready.timestamp;
+						tile.started = true;
+					}
+
+					if(now - tile.start >= tile.ready.timestamp) {
+						draw(tile, out);
+						tile.has_ready = false;
+					}
+				}
+
+				if(!tile.has_ready && !tile.ended) {
+					tile.busy.store(true, std::memory_order_relaxed);
+					pool.submit([this, &tile]{ decode(tile); });
+				}
+
+				playing = playing || !tile.ended || tile.has_ready;
+			}
+
+			// Every tile drawn this tick goes out in a single write
+			if(!out.empty()) {
+				out += "\x1b[0m";
+				present(out);
+			}
+
+			if(!playing) break;
+
+			// Skip ticks that were missed instead of rushing through them
+			next_tick += refresh;
+			if(next_tick < Clock::now()) next_tick = Clock::now();
+			std::this_thread::sleep_until(next_tick);
+		}
+
+		std::vector<std::string> errors;
+		for(auto &tile : tiles) {
+			if(!tile->error.empty()) errors.push_back(fmt::format("{}: {}", tile->source.path, tile->error));
+		}
+		return errors;
+	}
+};
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Player {
+
+/// Fixed set of threads running submitted jobs in order of submission
+class WorkerPool {
+	std::vector<std::thread> threads;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable available;
+	bool stopping = false;
+
+	void work() {
+		while(true) {
+			std::function<void()> job;
+			{
+				std::unique_lock lock(mutex);
+				available.wait(lock, [this]{ return stopping || !jobs.empty(); });
+				if(jobs.empty()) return; // Only once stopping
+
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+
+public:
+	/// @param count number of threads, one per core by default
+	explicit WorkerPool(size_t count = std::thread::hardware_concurrency()) {
+		count = std::max<size_t>(count, 1);
+		for(size_t i = 0; i < count; i++) threads.emplace_back(&WorkerPool::work, this);
+	}
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/// Finishes the jobs already submitted
+	~WorkerPool() {
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		available.notify_all();
+
+		for(auto &thread : threads) thread.join();
+	}
+
+	size_t size() const {
+		return threads.size();
+	}
+
+	void submit(std::function<void()> job) {
+		{
+			std::lock_guard lock(mutex);
+			jobs.push(std::move(job));
+		}
+		available.notify_one();
+	}
+};
+
+}
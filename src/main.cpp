@@ -2,9 +2,15 @@
 #include <chrono>
 #include <stdlib.h>
 #include <future>
+#include <thread>
 #include <filesystem>
 #include <sstream>
 #include <string>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
 // #include <format> No std::format support for g++ yet :(
 #include <fmt/core.h>
 
@@ -24,6 +30,19 @@
 #endif
 
 #include "flagmod/flags.hpp"
+#include "player/decoder.hpp"
+#include "player/opencv_decoder.hpp"
+#include "player/ffmpeg_decoder.hpp"
+#include "player/raw_decoder.hpp"
+#include "player/latest_frame.hpp"
+#include "player/encoder.hpp"
+#include "player/prefetch.hpp"
+#include "player/playlist.hpp"
+#include "player/audio.hpp"
+#include "player/recording.hpp"
+#include "player/layout.hpp"
+#include "player/wall.hpp"
+#include "player/convert.hpp"
 
 namespace fs = std::filesystem;
 
@@ -38,14 +57,70 @@ Unit now()
 	return std::chrono::duration_cast<Unit>(std::chrono::high_resolution_clock::now().time_since_epoch());
 }
 
-template <typename T>
-inline T &sample_array(cv::uint8_t v, std::vector<T> &vector) {
-	return vector[ v * vector.size() / 255 ];
+/**
+ * Opens the video with the requested backend, libav is preferred when it was compiled in
+ */
+std::unique_ptr<Player::Decoder> open_decoder(const Player::Source &source, const std::optional<std::string> &backend, const std::optional<Player::RawFormat> &raw)
+{
+	if(raw.has_value()) return std::make_unique<Player::RawDecoder>(source, *raw);
+#ifdef AVP_USE_FFMPEG
+	if(!backend.has_value() || *backend == "ffmpeg") return std::make_unique<Player::FFmpegDecoder>(source);
+#endif
+	if(!backend.has_value() || *backend == "opencv") return std::make_unique<Player::OpenCVDecoder>(source);
+
+	throw Player::DecoderError(fmt::format("unknown or unavailable decoder \"{}\"", *backend));
 }
 
-template <typename T>
-inline const T &sample_array(cv::uint8_t v, const std::vector<T> &vector) {
-	return vector[ v * vector.size() / 255 ];
+/**
+ * Returns the size of the console, in characters
+ */
+cv::Size terminal_size()
+{
+	// What is assumed when the output isn't a console (redirected to a file or a pipe)
+	const cv::Size fallback(80, 24);
+
+	int columns, rows;
+	
+	#ifdef _WIN32
+	// Windows
+	CONSOLE_SCREEN_BUFFER_INFO csbi;
+
+	if(!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) return fallback;
+	columns = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+	rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+	
+	#else
+	// Unix
+	
+	struct winsize w{};
+	if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) < 0 || w.ws_col == 0 || w.ws_row == 0) return fallback;
+	
+	columns = w.ws_col;
+	rows = w.ws_row;
+	
+	#endif
+
+	return cv::Size(columns, rows);
+}
+
+/**
+ * Limits a video size to the console size, keeping its aspect ratio
+ */
+cv::Size fit_to_terminal(cv::Size sourceSize)
+{
+	cv::Size terminal = terminal_size();
+	return Player::fit_cells(sourceSize, cv::Size(terminal.width, terminal.height - 2));
+}
+
+/**
+ * Writes an encoded frame to the terminal in one go, and to the recording if there is one
+ */
+void present(const std::string &encoded, Player::Recorder *recorder)
+{
+	std::fwrite(encoded.data(), 1, encoded.size(), stdout);
+	std::fflush(stdout);
+
+	if(recorder != nullptr) recorder->write(encoded);
 }
 
 int main(int argc, char *argv[])
@@ -57,7 +132,25 @@ int main(int argc, char *argv[])
 	auto flag_help = flags.flag("help", 'h', "Show this help and exit.");
 	auto flag_width = flags.option<unsigned int>("width", 'w', "Wanted width of the terminal in characters");
 	auto flag_height = flags.option<unsigned int>("height", 'h', "Wanted height of the terminal in characters");
-	auto flag_file = flags.positional<std::string>("file");
+	auto flag_decoder = flags.option<std::string>("decoder", "Video decoder to use: ffmpeg (when compiled in) or opencv");
+	auto flag_palette = flags.option<std::string>("palette", "Color palette: color, grayscale or truecolor, asked when not given");
+	auto flag_render = flags.option<std::string>("render", "How it should be rendered: block or ascii, asked when not given");
+	auto flag_follow = flags.option<float>("follow", "Keep reading a file still being written, until no data came for this many seconds");
+	auto flag_low_latency = flags.flag("low-latency", "Always show the newest decoded frame instead of every frame on time");
+	auto flag_raw_size = flags.option<std::string>("raw-size", "Read headerless frames of this size ({width}x{height}), as written by ffmpeg -f rawvideo");
+	auto flag_raw_format = flags.option<std::string>("raw-format", "Pixel format of raw frames: gray, bgr24 (default), rgb24 or yuv420p");
+	auto flag_fps = flags.option<double>("fps", "Frame rate of raw frames, they are shown as they arrive otherwise");
+	auto flag_playlist = flags.option<std::string>("playlist", "File listing videos to play, one per line");
+	auto flag_loop = flags.flag("loop", "Start over once every video was played");
+	auto flag_shuffle = flags.flag("shuffle", "Play videos in a random order");
+	auto flag_smooth = flags.flag("smooth", "Hold back cell changes too small to be more than noise, and only redraw cells that changed");
+	auto flag_noise_threshold = flags.option_required<int>("noise-threshold", "How far a cell's gray value has to move to be redrawn with --smooth", 12);
+	auto flag_record = flags.option<std::string>("record", "Save everything written to the terminal with its timing, for AsciiReplay");
+	auto flag_wall = flags.flag("wall", "Tile every video in one terminal and play them at the same time");
+	auto flag_refresh_rate = flags.option_required<double>("refresh-rate", "How many times per second the wall updates the terminal", 30.);
+	auto flag_convert = flags.option<std::string>("convert", "Convert the video to a recording for AsciiReplay as fast as possible, instead of playing it");
+	auto flag_jobs = flags.option<unsigned int>("jobs", 'j', "How many parts of the video --convert works on at once, one per core by default");
+	auto flag_files = flags.positional_list<std::string>("files");
 
 	auto [help] = flags.parse(flag_help);
 	if(help) {
@@ -65,272 +158,389 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	auto [width_, height_, videoPath] = flags.parse(flag_width, flag_height, flag_file);
+	auto [width_, height_, decoderName, palette, render, follow, lowLatency, rawSize, rawFormat, rawFps, playlistPath, loop, shuffle, smooth, noiseThreshold, recordPath, wall, refreshRate, convertPath, jobs, files] = flags.parse(
+		flag_width, flag_height, flag_decoder, flag_palette, flag_render, flag_follow, flag_low_latency, flag_raw_size, flag_raw_format, flag_fps,
+		flag_playlist, flag_loop, flag_shuffle, flag_smooth, flag_noise_threshold, flag_record, flag_wall, flag_refresh_rate, flag_convert, flag_jobs,
+		flag_files
+	);
+
+	Player::Source source;
+	if(follow.has_value()) source.follow = std::chrono::milliseconds(static_cast<long>(*follow * 1000));
+	source.low_latency = lowLatency;
 
-	if(!fs::exists(videoPath) || fs::is_directory(videoPath))
+	Player::Playlist playlist(loop, shuffle);
+	try
 	{
-		std::cout << "Non valid video path given.\n";
+		for(auto &file : files) playlist.add(file);
+		if(playlistPath.has_value()) playlist.add_playlist(*playlistPath);
+	}
+	catch(Player::DecoderError &e)
+	{
+		std::cout << e.msg << '\n';
 		return -1;
 	}
 
-	enum CharMode
+	if(playlist.size() == 0)
 	{
-		BLOCK,
-		ASCII,
-	} chrMode = BLOCK;
+		std::cout << "No video given.\n";
+		return -1;
+	}
+
+	bool readsStdin = playlist.reads_stdin();
+
+	Player::CharMode chrMode = Player::BLOCK;
+	Player::ColorMode colorMode = Player::COLOR;
 
-	enum ColorMode
-	{
-		GRAYSCALE,
-		COLOR,
-		TRUE_COLOR
-	} colorMode = COLOR;
-	
 	{
-		char input[1024];
-		
-		while(true)
+		// Answers given as options skip the question, and nothing can be asked when the video itself comes from stdin
+		auto answer = [readsStdin](const char *question, const std::optional<std::string> &given)
 		{
-			std::cout << "Color palette([C]olor(default), [G]rayscale, [T]rue Color): ";
+			char input[1024] = "";
+			if(given.has_value()) return given->empty() ? '\0' : given->front();
+			if(readsStdin) return '\0';
+
+			std::cout << question;
 			std::cin.getline(input, 2, '\n');
-			
-			switch(input[0])
+			return input[0];
+		};
+
+		while(true)
+		{
+			switch(answer("Color palette([C]olor(default), [G]rayscale, [T]rue Color): ", palette))
 			{
 				case 'c':
 				case 'C':
 				case ' ':
 				case '\0':
-					colorMode = COLOR;
+					colorMode = Player::COLOR;
 					break;
 				case 'g':
 				case 'G':
-					colorMode = GRAYSCALE;
+					colorMode = Player::GRAYSCALE;
 					break;
 				case 't':
 				case 'T':
-					colorMode = TRUE_COLOR;
+					colorMode = Player::TRUE_COLOR;
 					break;
 				default:
+					if(palette.has_value())
+					{
+						std::cout << "Non valid palette given.\n";
+						return -1;
+					}
 					continue;
 			}
-			
+
 			break;
 		}
 
 		while(true)
 		{
-			std::cout << "How it should be rendered([B]lock(default), [A]scii): ";
-			std::cin.getline(input, 2, '\n');
-
-			switch(input[0])
+			switch(answer("How it should be rendered([B]lock(default), [A]scii): ", render))
 			{
 				case 'b':
 				case 'B':
 				case '\0':
 				case ' ':
-					chrMode = BLOCK;
+					chrMode = Player::BLOCK;
 					break;
 				case 'a':
 				case 'A':
-					chrMode = ASCII;
+					chrMode = Player::ASCII;
 					break;
 				default:
+					if(render.has_value())
+					{
+						std::cout << "Non valid render mode given.\n";
+						return -1;
+					}
 					continue;
 			}
 
 			break;
 		}
 	}
-	
+
+	const Player::Encoder encoder(chrMode, colorMode);
+
 	#pragma region Setup Capture
-	
-	cv::VideoCapture cap{ videoPath };
-	
-	if(!cap.isOpened())
+
+	std::optional<Player::RawFormat> raw;
+	try
+	{
+		if(rawSize.has_value()) raw = Player::RawFormat::parse(*rawSize, rawFormat.value_or("bgr24"), rawFps.value_or(0.));
+	}
+	catch(Player::DecoderError &e)
 	{
-		std::cout << "Error while opening video" << std::endl;
+		std::cout << e.msg << '\n';
 		return -1;
 	}
-	
-	cv::Mat startFrame;
-	cap >> startFrame;
-	
-	cv::resize(startFrame, startFrame, cv::Size(), 1., 0.5);
-	
-	int width = startFrame.cols;
-	int height = startFrame.rows;
 
-	// Limit video size to console size
-	// Scope for cleanness
+	if(convertPath.has_value())
 	{
-		int columns, rows;
-		
-		#ifdef _WIN32
-		// Windows
-		CONSOLE_SCREEN_BUFFER_INFO csbi;
-
-		GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
-		columns = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-		rows = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
-		
-		#else
-		// Unix
-		
-		struct winsize w;
-		ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-		
-		columns = w.ws_col;
-		rows = w.ws_row;
-		
-		#endif
-		
-		float fWidth = static_cast<float>(width);
-		float fHeight = static_cast<float>(height);
-		
-		if(fHeight > rows - 2)
+		if(playlist.size() != 1)
 		{
-			fHeight = rows - 2;
-			
-			fWidth = fWidth / ( ( fWidth / fHeight ) / ( static_cast<float>( startFrame.cols ) / startFrame.rows ) );
+			std::cout << "Only one video can be converted at a time.\n";
+			return -1;
 		}
-		
-		if(fWidth > columns)
+
+		Player::Source convertSource = source;
+		convertSource.path = *playlist.next();
+
+		// Every segment opens the video again, which stdin, pipes and devices can't be
+		if(convertSource.is_stdin() || !fs::is_regular_file(convertSource.path))
 		{
-			fWidth = columns;
-			
-			fHeight = fHeight * ( ( fWidth / fHeight ) / ( static_cast<float>( startFrame.cols ) / startFrame.rows ) );
+			std::cout << "Only regular files can be converted.\n";
+			return -1;
 		}
-		
-		// Truncate towards zero
-		width = static_cast<int>(fWidth);
-		height = static_cast<int>(fHeight);
-	}
-	
-	#pragma endregion
-	
-	// Since they are unicode, they need to be stored as pointer arrays
-	void (*transformer)(cv::uint8_t, cv::Vec3b, std::string &);
 
-	std::vector<const char *> greyscaleChars =
-	{
-		"\x1b[48;5;232m ", "\x1b[48;5;234m ", "\x1b[48;5;236m ",
-		"\x1b[48;5;238m ", "\x1b[48;5;240m ", "\x1b[48;5;242m ",
-		"\x1b[48;5;244m ", "\x1b[48;5;246m ", "\x1b[48;5;248m ",
-		"\x1b[48;5;250m ", "\x1b[48;5;252m ", "\x1b[48;5;254m "
-	};
+		auto open = [&](const Player::Source &segmentSource) { return open_decoder(segmentSource, decoderName, raw); };
 
-	// buffer += chars[static_cast<int>(std::floor(chars.size() * value / 256.))];
+		try
+		{
+			auto probe = open(convertSource);
 
-	switch(chrMode)
-	{
-		case BLOCK:
-			if(colorMode == TRUE_COLOR) transformer = [](cv::uint8_t, cv::Vec3b value, std::string &buffer) {
-				buffer += fmt::format("\x1b[48;2;{};{};{}m ", value[2], value[1], value[0]);
-			};
-			else if(colorMode == COLOR) transformer = [](cv::uint8_t, cv::Vec3b value, std::string &buffer) {
-				buffer += fmt::format("\x1b[48;5;{}m ", 16 + value[0]/43 + value[1]/43*6 + value[2]/43*36);
-			};
-			else transformer = [](cv::uint8_t value, cv::Vec3b, std::string &buffer) {
-				const std::vector<const char *> blockChars = { " ", "\u2591", "\u2592", "\u2593", "\u2589" };
-
-				buffer += sample_array(value, blockChars);
-			};
-			break;
-		case ASCII:
-			if(colorMode == TRUE_COLOR) transformer = [](cv::uint8_t g, cv::Vec3b value, std::string &buffer) {
-				const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
-
-				// Boost color to max brightness to counteract character size = dimming
-				uint8_t maxValue = std::max(value[0], std::max(value[1], value[2]));
-				float diff = 255.0 / maxValue;
-				value[0] *= diff;
-				value[1] *= diff;
-				value[2] *= diff;
-
-				buffer += fmt::format("\x1b[38;2;{};{};{}m{}", value[2], value[1], value[0], sample_array(g, asciiChars));
-			};
-			else if(colorMode == COLOR) transformer = [](cv::uint8_t g, cv::Vec3b value, std::string &buffer) {
-				const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
-
-				buffer += fmt::format("\x1b[38;5;{}m{}", 16 + value[0]/43 + value[1]/43*6 + value[2]/43*36, sample_array(g, asciiChars));
-			};
-			else transformer = [](cv::uint8_t value, cv::Vec3b, std::string &buffer) {
-				const std::vector<char> asciiChars = { ' ', '.', '\"', ',', ':', '-', '~', '=', '|', '(', '{', '[', '&', '#', '@' };
-
-				buffer += sample_array(value, asciiChars);
-			};
-			break;
+			// Conversions are made ahead of time, their size doesn't depend on whatever terminal they were made in
+			cv::Size bounds(width_.value_or(80), height_.value_or(24));
+			cv::Size size = Player::fit_cells(probe->source_size(), bounds);
+			if(size.width < 1 || size.height < 1)
+			{
+				std::cout << "Non valid output size, give one with --width and --height.\n";
+				return -1;
+			}
+
+			Player::Recorder output(*convertPath, size.width, size.height + 1);
+			Player::Converter converter(encoder, open, size, smooth ? std::optional<int>(noiseThreshold) : std::nullopt,
+				jobs.value_or(std::max(std::thread::hardware_concurrency(), 1u))
+			);
+
+			auto frames = converter.run(convertSource, *probe, output, [](uint64_t done, uint64_t expected, std::chrono::duration<double> elapsed)
+			{
+				double rate = done / std::max(elapsed.count(), 1e-3);
+				if(expected > done && rate > 0.) fmt::print(stderr, "\r{}/{} frames, {:.1f} frames/s, {:.0f}s left ", done, expected, rate, (expected - done) / rate);
+				else fmt::print(stderr, "\r{} frames, {:.1f} frames/s ", done, rate);
+			});
+			output.close();
+
+			fmt::print(stderr, "\nConverted {} frames to {}\n", frames, *convertPath);
+		}
+		catch(Player::DecoderError &e)
+		{
+			std::cerr << "\nError while converting video: " << e.msg << std::endl;
+			return -1;
+		}
+		catch(cv::Exception &e)
+		{
+			std::cerr << "\nError while converting video: " << e.what() << std::endl;
+			return -1;
+		}
+		catch(Player::RecordingError &e)
+		{
+			std::cout << e.msg << '\n';
+			return -1;
+		}
+		return 0;
 	}
-	
-	// Start music
-	std::future<void> playMusic(std::async(std::launch::async,
-		[](const std::string &videoPath)
+
+	std::unique_ptr<Player::Recorder> recorder;
+	if(recordPath.has_value())
+	{
+		try
 		{
-			std::string cmd = fmt::format("mplayer -vo null -slave \"{}\" {}", videoPath, "> /dev/null");
-			system(cmd.c_str());
-		}, videoPath
-	));
-	
-	auto updateDelay = 1000000us*1000 / static_cast<long>(1000 * cap.get(cv::CAP_PROP_FPS));
-	auto startTime = now<std::chrono::microseconds>();
-	// Clear console
-	std::cout << "\x1b[2J";
-	
-	std::setvbuf(stdout, nullptr, _IOFBF, BUFSIZ); // Set stdout to be fully buffered
+			cv::Size terminal = terminal_size();
+			recorder = std::make_unique<Player::Recorder>(*recordPath, terminal.width, terminal.height);
+		}
+		catch(Player::RecordingError &e)
+		{
+			std::cout << e.msg << '\n';
+			return -1;
+		}
+	}
 
-	std::string buffer;
-	while(true)
+	if(wall)
 	{
-		auto elapsedTime = ( now<std::chrono::microseconds>() - startTime );
-		int index = elapsedTime / updateDelay;
+		if(refreshRate <= 0.)
+		{
+			std::cout << "Non valid refresh rate given.\n";
+			return -1;
+		}
 
-		for(int k = 1; k < index; k++)
+		Player::Wall videoWall(encoder,
+			[&](const Player::Source &tileSource) { return open_decoder(tileSource, decoderName, raw); },
+			smooth ? std::optional<int>(noiseThreshold) : std::nullopt, loop, refreshRate
+		);
+
+		for(size_t i = 0; i < playlist.size(); i++)
 		{
-			if(k >= index-1)
+			Player::Source tileSource = source;
+			tileSource.path = *playlist.next();
+			try
 			{
-				cv::Mat frame, grayFrame;
-
-				if(!cap.read(frame)) goto endLoop;
-
-				cv::resize(frame, frame, cv::Size(width, height), 0., 0., cv::INTER_AREA);
-				
-				grayFrame = frame.clone();
-				cv::cvtColor(grayFrame, grayFrame, cv::COLOR_BGR2GRAY);
-				
-				fmt::print("\x1b[1;1H");
-				
-				for(int j = 0; j < frame.rows; j++)
-				{
-					buffer.clear();
-					for(int i = 0; i < frame.cols; i++)
-					{
-						uint8_t gray = grayFrame.at<uint8_t>(j, i);
-						cv::Vec3b value = frame.at<cv::Vec3b>(j, i);
+				videoWall.add(tileSource);
+			}
+			catch(Player::DecoderError &e)
+			{
+				std::cerr << "Error while opening video: " << e.msg << std::endl;
+			}
+		}
+		if(videoWall.size() == 0) return -1;
 
-						transformer(gray, value, buffer);
-					}
+		std::setvbuf(stdout, nullptr, _IOFBF, BUFSIZ); // Set stdout to be fully buffered
+		present("\x1b[2J", recorder.get());
+
+		// Keep the last line free, drawing on it could scroll the screen
+		cv::Size terminal = terminal_size();
+		auto errors = videoWall.run(cv::Size(terminal.width, terminal.height - 1), [&recorder](const std::string &out) { present(out, recorder.get()); });
+
+		for(auto &error : errors) std::cerr << "Error while playing video: " << error << std::endl;
+		return 0;
+	}
+
+	// Frames decoded and encoded in advance for each video, enough to cover opening the one after it
+	constexpr size_t prefetchCount = 8;
+
+	/**
+	 * Opens the next video that can be opened and prepares its first frames, the strings of `spare` are reused
+	 * Runs in the background while the previous video plays
+	 */
+	auto openNext = [&](std::vector<Player::EncodedFrame> spare) -> std::optional<Player::PreparedVideo>
+	{
+		// Give up once every entry failed in a row, instead of spinning on a looping playlist of broken files
+		for(size_t failures = 0; failures < playlist.size(); failures++)
+		{
+			std::optional<std::string> path = playlist.next();
+			if(!path.has_value()) return std::nullopt;
 
-					buffer += '\n';
-					fmt::print("{}", buffer);
+			Player::PreparedVideo video;
+			video.source = source;
+			video.source.path = *path;
+
+			// A regular file is all there already, showing the newest frame would only play it at decoding speed
+			bool live = video.source.is_stdin() || video.source.follow.has_value() || !fs::is_regular_file(*path);
+			video.source.low_latency = video.source.low_latency && live;
+			try
+			{
+				// "-" reads stdin, named pipes are fine too
+				if(!video.source.is_stdin() && (!fs::exists(*path) || fs::is_directory(*path)))
+				{
+					throw Player::DecoderError(fmt::format("non valid video path \"{}\"", *path));
 				}
-				
-				fmt::print("\x1b[0m");
-				std::cout.flush();
+
+				video.decoder = open_decoder(video.source, decoderName, raw);
+				video.size = fit_to_terminal(video.decoder->source_size());
+				video.decoder->set_output_size(video.size);
+				video.decoder->set_need_color(encoder.needs_color());
+				if(smooth) video.filter.emplace(Player::TemporalFilter::default_history, noiseThreshold, encoder.needs_color());
+
+				// Frames of a live source would be stale by the time they are shown, it starts with the newest one instead
+				Player::prefetch(video, encoder, video.source.low_latency ? 0 : prefetchCount, std::move(spare));
+				return video;
 			}
-			else
+			catch(Player::DecoderError &e)
 			{
-				if(!cap.grab()) goto endLoop;
+				std::cerr << "Error while opening video: " << e.msg << std::endl;
 			}
+		}
+		return std::nullopt;
+	};
+
+	std::future<std::optional<Player::PreparedVideo>> upcoming = std::async(std::launch::async, openNext, std::vector<Player::EncodedFrame>{});
+	std::optional<Player::PreparedVideo> current = upcoming.get();
+	if(!current.has_value()) return -1;
+
+	#pragma endregion
 
-			startTime += updateDelay;
+	// One mplayer for the whole playlist, streams can't be read a second time so they play silently
+	Player::Audio audio;
+
+	std::setvbuf(stdout, nullptr, _IOFBF, BUFSIZ); // Set stdout to be fully buffered
+
+	// Clear console
+	present("\x1b[2J", recorder.get());
+
+	cv::Size shownSize = current->size;
+	std::string encoded;
+	Player::Frame frame;
+
+	while(current.has_value())
+	{
+		Player::PreparedVideo &video = *current;
+		Player::Decoder &decoder = *video.decoder;
+
+		// Videos of the same size draw over each other, no need to blank the screen in between
+		if(video.size != shownSize)
+		{
+			present("\x1b[2J", recorder.get());
+			shownSize = video.size;
+		}
+
+		if(fs::is_regular_file(video.source.path) && !video.source.follow.has_value()) audio.play(video.source.path);
+		else audio.stop();
+
+		// Frames are shown at their own timestamp, start the clock so that the first one is due now
+		auto startTime = now<std::chrono::microseconds>() - (video.frames.empty() ? 0us : video.frames.front().timestamp);
+
+		for(auto &prepared : video.frames)
+		{
+			std::this_thread::sleep_for(startTime + prepared.timestamp - now<std::chrono::microseconds>());
+			present(prepared.text, recorder.get());
+		}
+
+		// Start on the next video once this one is going, with the strings that were just shown
+		upcoming = std::async(std::launch::async, openNext, std::move(video.frames));
+
+		if(video.finished)
+		{
+			// Everything was prefetched already
+		}
+		else if(video.source.low_latency)
+		{
+			// Decode as fast as the source delivers on another thread, and only ever show the most recent frame
+			Player::LatestFrame latest;
+			std::thread reader([&decoder, &latest]
+			{
+				Player::Frame decoded;
+				while(decoder.read(decoded)) latest.publish(decoded);
+				latest.finish();
+			});
+
+			uint64_t seen = 0;
+			while(latest.wait_newer(seen, frame))
+			{
+				video.encode(encoder, frame, encoded);
+				present(encoded, recorder.get());
+			}
+
+			reader.join();
+		}
+		else
+		{
+			// Being more than a couple frames late means frames have to be dropped, without an announced frame rate it is measured
+			std::chrono::microseconds frameDelay = decoder.fps() > 0. ? std::chrono::microseconds(static_cast<long>(1000000. / decoder.fps())) : 40000us;
+
+			while(true)
+			{
+				bool ended = false;
+				while(!ended && decoder.timestamp() + 2 * frameDelay < now<std::chrono::microseconds>() - startTime)
+				{
+					ended = !decoder.grab();
+				}
+
+				auto previousTimestamp = decoder.timestamp();
+				if(ended || !decoder.read(frame)) break;
+
+				if(decoder.fps() <= 0. && frame.timestamp > previousTimestamp) frameDelay = frame.timestamp - previousTimestamp;
+
+				video.encode(encoder, frame, encoded);
+
+				std::this_thread::sleep_for(startTime + frame.timestamp - now<std::chrono::microseconds>());
+				present(encoded, recorder.get());
+			}
 		}
+
+		current.reset();
+		current = upcoming.get();
 	}
 
-endLoop:
-	
-	cap.release();
-	
-	playMusic.get();
-	
 	return 0;
 }
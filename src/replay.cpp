@@ -0,0 +1,96 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <fmt/core.h>
+
+#include "flagmod/flags.hpp"
+#include "player/recording.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Replays the terminal output captured by `AsciiVideoPlayer --record`
+ * Measures how fast the output can be consumed, apart from decoding and encoding
+ */
+int main(int argc, char *argv[])
+{
+	auto flags = FlagMod::Flags(argc, argv)
+		.name("AsciiReplay")
+		.version("1.3.0");
+
+	auto flag_help = flags.flag("help", 'h', "Show this help and exit.");
+	auto flag_speed = flags.option_required<double>("speed", 's', "Playback speed relative to the recording", 1.);
+	auto flag_max_speed = flags.flag("max-speed", "Write frames as fast as the output takes them, ignoring timestamps");
+	auto flag_output = flags.option<std::string>("output", 'o', "Write the stream to this file instead of the terminal, as fast as possible");
+	auto flag_cast = flags.option<std::string>("cast", "Export the recording as an asciicast v2 file and exit");
+	auto flag_recording = flags.positional<std::string>("recording");
+
+	auto [help] = flags.parse(flag_help);
+	if(help) {
+		flags.print_help();
+		return -1;
+	}
+
+	auto [speed, maxSpeed, outputPath, castPath, recordingPath] = flags.parse(flag_speed, flag_max_speed, flag_output, flag_cast, flag_recording);
+
+	try
+	{
+		Player::Recording recording(recordingPath);
+
+		if(castPath.has_value())
+		{
+			FILE *cast = std::fopen(castPath->c_str(), "w");
+			if(cast == nullptr)
+			{
+				std::cerr << "Couldn't create " << *castPath << '\n';
+				return -1;
+			}
+
+			Player::write_asciicast(recording, cast);
+			std::fclose(cast);
+			return 0;
+		}
+
+		FILE *output = stdout;
+		if(outputPath.has_value())
+		{
+			output = std::fopen(outputPath->c_str(), "wb");
+			if(output == nullptr)
+			{
+				std::cerr << "Couldn't create " << *outputPath << '\n';
+				return -1;
+			}
+		}
+
+		bool paced = !maxSpeed && !outputPath.has_value() && speed > 0.;
+
+		size_t bytes = 0;
+		auto startTime = std::chrono::steady_clock::now();
+		for(size_t i = 0; i < recording.size(); i++)
+		{
+			auto frame = recording[i];
+
+			if(paced) std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::microseconds>(frame.timestamp / speed));
+
+			std::fwrite(frame.bytes.data(), 1, frame.bytes.size(), output);
+			std::fflush(output);
+			bytes += frame.bytes.size();
+		}
+		auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		if(output != stdout) std::fclose(output);
+
+		fmt::print(stderr, "\x1b[0m\n{} frames, {:.2f} MB in {:.3f}s: {:.1f} frames/s, {:.2f} MB/s\n",
+			recording.size(), bytes / 1e6, elapsed, recording.size() / elapsed, bytes / 1e6 / elapsed
+		);
+	}
+	catch(Player::RecordingError &e)
+	{
+		std::cerr << e.msg << '\n';
+		return -1;
+	}
+
+	return 0;
+}